@@ -0,0 +1,606 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "xmem.h"
+#include "dict.h"
+#include "score.h"
+#include "matrix.h"
+#include "solver.h"
+#include "stats.h"
+#include "stream.h"
+#include "dawg.h"
+#include "hard.h"
+
+#define RND_IMPLEMENTATION
+#include "rnd.h"
+
+/* the synthetic word list is all of this length */
+#define BENCH_LEN WORD_LEN_DEFAULT
+#define BENCH_WORDS 250000
+#define BENCH_LOOKUPS 2000
+/* the linear scan is slow enough that a few do */
+#define BENCH_LINEAR_LOOKUPS 100
+#define BENCH_GUESSES 20
+#define BENCH_MATRIX_WORDS 8192
+/* lines in the synthetic dictionary files */
+#define BENCH_FILE_LINES 2000000
+#define BENCH_RND 1000000
+/* values a bulk fill makes at a time */
+#define BENCH_FILL 1000
+/* every benchmark is repeated for at least this long */
+#define BENCH_MIN_SECS 0.25
+
+/* Run body until BENCH_MIN_SECS have passed, and report it as ops operations
+ * over bytes bytes a run. */
+#define BENCH(name, ops, bytes, body) do { \
+	size_t bench_runs_ = 0; \
+	double bench_t_ = now(), bench_secs_; \
+	do { \
+		body; \
+		++bench_runs_; \
+	} while ((bench_secs_ = now() - bench_t_) < BENCH_MIN_SECS); \
+	report(name, bench_secs_, bench_runs_ * (size_t)(ops), bench_runs_ * (size_t)(bytes)); \
+} while (0)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void random_word(rnd_pcg_t *pcg, char *buf)
+{
+	int i;
+	for (i = 0; i < BENCH_LEN; ++i) {
+		buf[i] = 'a' + rnd_pcg_range(pcg, 0, 25);
+	}
+	buf[BENCH_LEN] = '\0';
+}
+
+/* the old valid_word() */
+static bool linear_find(char **words, size_t count, const char *s)
+{
+	size_t i;
+	for (i = 0; i < count; ++i) {
+		if (!strcmp(s, words[i]))
+			return true;
+	}
+	return false;
+}
+
+/* remove a scratch directory and the files in it */
+static void remove_dir(const char *path)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char *file;
+
+	if ((dir = opendir(path))) {
+		while ((ent = readdir(dir))) {
+			if (ent->d_name[0] == '.')
+				continue;
+			xasprintf(&file, "%s/%s", path, ent->d_name);
+			unlink(file);
+			free(file);
+		}
+		closedir(dir);
+	}
+	rmdir(path);
+}
+
+/* What the original read_all_lines() had malloc hand out for the words of
+ * d: the pointer array, and the buffer getline() gave each line. */
+static size_t lines_bytes(const struct dict *d)
+{
+	char *text, *line, **lines;
+	size_t i, n, total;
+	FILE *f;
+
+	text = xcalloc(d->count + 1, d->len + 1);
+	for (i = 0; i < d->count; ++i) {
+		word_unpack(d->words[i], text + i * (d->len + 1));
+		text[i * (d->len + 1) + d->len] = '\n';
+	}
+	if (!(f = fmemopen(text, d->count * (d->len + 1) + 1, "r"))) {
+		perror("fmemopen");
+		exit(1);
+	}
+	lines = xcalloc(d->count + 1, sizeof(*lines));
+	total = malloc_usable_size(lines);
+	for (i = 0; i < d->count; ++i) {
+		line = NULL;
+		n = 0;
+		if (getline(&line, &n, f) == -1)
+			break;
+		total += malloc_usable_size(line);
+		free(line);
+	}
+	fclose(f);
+	free(lines);
+	free(text);
+	return total;
+}
+
+/* what it takes to hold the words of d in each layout, the char ** being
+ * the original one */
+static void footprint(const struct dict *d, const struct dawg *g)
+{
+	printf("%-24s %12zu bytes\n", "char **", lines_bytes(d));
+	printf("%-24s %12zu bytes\n", "packed + hash index", (d->count + d->mask + 1) * sizeof(word_t));
+	printf("%-24s %12zu bytes\n", "dawg", dawg_bytes(g));
+}
+
+/* bytes is 0 where throughput means nothing */
+static void report(const char *name, double secs, size_t ops, size_t bytes)
+{
+	printf("%-24s %12.1f ns/op", name, secs * 1e9 / ops);
+	if (bytes) {
+		printf(" %10.1f MB/s", bytes / secs / 1e6);
+	}
+	putchar('\n');
+}
+
+/* write a dictionary file of n lines of min to max letters to path,
+ * returning its size */
+static size_t write_dict(const char *path, rnd_pcg_t *pcg, size_t n, int min, int max)
+{
+	FILE *f;
+	size_t i, size = 0;
+	int j, len;
+
+	if (!(f = fopen(path, "w"))) {
+		perror("write dictionary");
+		exit(1);
+	}
+	for (i = 0; i < n; ++i) {
+		len = rnd_pcg_range(pcg, min, max);
+		for (j = 0; j < len; ++j) {
+			fputc('a' + rnd_pcg_range(pcg, 0, 25), f);
+		}
+		fputc('\n', f);
+		size += len + 1;
+	}
+	fclose(f);
+	return size;
+}
+
+int main(void)
+{
+	rnd_pcg_t pcg;
+	rnd_pcg8_t pcg8;
+	RND_U32 seeds[RND_PCG8_LANES], fill[BENCH_FILL];
+	rnd_well_t well;
+	rnd_gamerand_t gamerand;
+	rnd_xorshift_t xorshift;
+	char **words, **probe, **copy;
+	struct xarena arena = {0}, scratch = {0};
+	struct dict d;
+	struct lexicon loaded;
+	struct stream_sample stream;
+	struct bloom bloom;
+	struct dawg dawg;
+	const char *real;
+	struct scorer score;
+	word_t *packed;
+	pattern_t *pat, *want;
+	uint8_t *pat8;
+	struct dict sub;
+	struct pattern_matrix m;
+	struct opener *op;
+	struct hard rules;
+	word_t *kept;
+	char tmpdir[] = "/tmp/cordl-bench-XXXXXX";
+	char *path;
+	size_t gs[GAMESTAT_MAX] = {0};
+	const size_t gs_size = GAMESTAT_LEN(ROW_DEFAULT) * sizeof(*gs);
+	size_t i, j, found, size;
+	FILE *f;
+	volatile uint32_t sink = 0;
+	double t;
+	char name[32];
+	int fd, len;
+
+	rnd_pcg_seed(&pcg, 1);
+	if (!mkdtemp(tmpdir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	words = xcalloc(BENCH_WORDS, sizeof(*words));
+	for (i = 0; i < BENCH_WORDS; ++i) {
+		words[i] = xarena_alloc(&arena, BENCH_LEN + 1);
+		random_word(&pcg, words[i]);
+	}
+	/* hits are drawn from the list, misses use an uppercase letter so they
+	 * can never match */
+	probe = xcalloc(BENCH_LOOKUPS * 2, sizeof(*probe));
+	for (i = 0; i < BENCH_LOOKUPS; ++i) {
+		probe[i] = words[rnd_pcg_range(&pcg, 0, BENCH_WORDS - 1)];
+		probe[BENCH_LOOKUPS + i] = xarena_alloc(&arena, BENCH_LEN + 1);
+		random_word(&pcg, probe[BENCH_LOOKUPS + i]);
+		probe[BENCH_LOOKUPS + i][0] = 'A';
+	}
+
+	/* a copy of every word, one allocation each, then all freed */
+	copy = xcalloc(BENCH_WORDS, sizeof(*copy));
+	BENCH("word copies (xstrdup)", BENCH_WORDS, 0, {
+		for (i = 0; i < BENCH_WORDS; ++i) {
+			copy[i] = xstrdup(words[i]);
+		}
+		for (i = 0; i < BENCH_WORDS; ++i) {
+			free(copy[i]);
+		}
+	});
+	BENCH("word copies (xarena)", BENCH_WORDS, 0, {
+		for (i = 0; i < BENCH_WORDS; ++i) {
+			copy[i] = xarena_strndup(&scratch, words[i], BENCH_LEN);
+		}
+		xarena_reset(&scratch);
+	});
+	xarena_free(&scratch);
+	free(copy);
+
+	xasprintf(&path, "%s/words", tmpdir);
+	/* lines too long to be words only need validating */
+	size = write_dict(path, &pcg, BENCH_FILE_LINES, WORD_LEN_MAX + 1, 16);
+	printf("%d lines (%.1f MB) to load\n", BENCH_FILE_LINES, size / 1e6);
+	BENCH("lexicon_load (no words)", 1, size, {
+		lexicon_load(&loaded, path, 0);
+		lexicon_free(&loaded);
+	});
+	size = write_dict(path, &pcg, BENCH_FILE_LINES, WORD_LEN_MIN - 1, WORD_LEN_MAX + 1);
+	printf("%d lines (%.1f MB) to load\n", BENCH_FILE_LINES, size / 1e6);
+	BENCH("lexicon_load (1 thread)", 1, size, {
+		lexicon_load(&loaded, path, 1);
+		lexicon_free(&loaded);
+	});
+	BENCH("lexicon_load", 1, size, {
+		lexicon_load(&loaded, path, 0);
+		lexicon_free(&loaded);
+	});
+	BENCH("stream_sample", 1, size, {
+		f = fopen(path, "r");
+		stream_sample(&stream, f, BENCH_LEN, &pcg);
+		fclose(f);
+		stream_sample_free(&stream);
+	});
+	/* the first lexicon_open writes the index, the rest only map it, so
+	 * the text's size says nothing about them */
+	lexicon_open(&loaded, path, tmpdir, 0);
+	lexicon_free(&loaded);
+	BENCH("lexicon_open (cached)", 1, 0, {
+		lexicon_open(&loaded, path, tmpdir, 0);
+		lexicon_free(&loaded);
+	});
+	free(path);
+
+	printf("%d words, %d lookups\n", BENCH_WORDS, BENCH_LOOKUPS);
+
+	d.len = BENCH_LEN;
+	d.words = xcalloc(BENCH_WORDS, sizeof(*d.words));
+	d.count = BENCH_WORDS;
+	for (i = 0; i < BENCH_WORDS; ++i) {
+		d.words[i] = word_pack(words[i]);
+	}
+	packed = xcalloc(BENCH_LOOKUPS * 2, sizeof(*packed));
+	for (i = 0; i < BENCH_LOOKUPS; ++i) {
+		packed[i] = word_pack(probe[i]);
+		/* a packed miss that still has to be probed for */
+		packed[BENCH_LOOKUPS + i] = packed[i] | (word_t)1 << 63;
+	}
+
+	t = now();
+	dict_index_build(&d);
+	report("index build (per word)", now() - t, BENCH_WORDS, 0);
+
+	/* every lookup is checked once up front, so the loops can just count */
+	found = 0;
+	for (i = 0; i < BENCH_LINEAR_LOOKUPS; ++i) {
+		found += linear_find(words, BENCH_WORDS, probe[i]);
+		found += linear_find(words, BENCH_WORDS, probe[BENCH_LOOKUPS + i]);
+	}
+	for (i = 0; i < BENCH_LOOKUPS; ++i) {
+		found += dict_contains(&d, word_pack(probe[i]));
+		found += dict_contains(&d, word_pack(probe[BENCH_LOOKUPS + i]));
+		found += dict_contains(&d, packed[BENCH_LOOKUPS + i]);
+	}
+	if (found != BENCH_LINEAR_LOOKUPS + BENCH_LOOKUPS) {
+		fprintf(stderr, "lookup mismatch: %zu\n", found);
+		return 1;
+	}
+
+	BENCH("linear scan hit", BENCH_LINEAR_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LINEAR_LOOKUPS; ++i) {
+			sink += linear_find(words, BENCH_WORDS, probe[i]);
+		}
+	});
+	BENCH("linear scan miss", BENCH_LINEAR_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LINEAR_LOOKUPS; ++i) {
+			sink += linear_find(words, BENCH_WORDS, probe[BENCH_LOOKUPS + i]);
+		}
+	});
+	/* what valid_word() does: pack the typed word and look it up */
+	BENCH("valid_word hit", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dict_contains(&d, word_pack(probe[i]));
+		}
+	});
+	BENCH("valid_word miss", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dict_contains(&d, word_pack(probe[BENCH_LOOKUPS + i]));
+		}
+	});
+	BENCH("hash index hit", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dict_contains(&d, packed[i]);
+		}
+	});
+	BENCH("hash index miss", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dict_contains(&d, packed[BENCH_LOOKUPS + i]);
+		}
+	});
+	/* --answers turns away most guesses outside the answers this way */
+	bloom_init(&bloom, d.count);
+	for (i = 0; i < d.count; ++i) {
+		bloom_add(&bloom, d.words[i]);
+	}
+	BENCH("bloom hit", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += bloom_maybe(&bloom, packed[i]);
+		}
+	});
+	BENCH("bloom miss", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += bloom_maybe(&bloom, packed[BENCH_LOOKUPS + i]);
+		}
+	});
+	bloom_free(&bloom);
+
+	t = now();
+	if (dawg_open(&dawg, &d, NULL) == -1) {
+		perror("dawg_open");
+		return 1;
+	}
+	report("dawg build (per word)", now() - t, d.count, 0);
+	BENCH("dawg hit", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dawg_contains(&dawg, packed[i]);
+		}
+	});
+	BENCH("dawg miss", BENCH_LOOKUPS, 0, {
+		for (i = 0; i < BENCH_LOOKUPS; ++i) {
+			sink += dawg_contains(&dawg, packed[BENCH_LOOKUPS + i]);
+		}
+	});
+	/* random words share little, so this is about the worst case */
+	printf("memory for %zu random words\n", d.count);
+	footprint(&d, &dawg);
+	dawg_free(&dawg);
+	if (!(real = getenv("CORDL_WORDS"))) {
+		real = "/usr/share/dict/words";
+	}
+	if (lexicon_open(&loaded, real, NULL, 0) == 0) {
+		if (dawg_open(&dawg, &loaded.by_len[BENCH_LEN], NULL) == 0) {
+			printf("memory for the %zu %d letter words of %s\n", loaded.by_len[BENCH_LEN].count, BENCH_LEN, real);
+			footprint(&loaded.by_len[BENCH_LEN], &dawg);
+			dawg_free(&dawg);
+		}
+		lexicon_free(&loaded);
+	}
+
+	scorer_init(&score, BENCH_LEN);
+	pat = xcalloc(BENCH_WORDS, sizeof(*pat));
+	want = xcalloc(BENCH_WORDS, sizeof(*want));
+	BENCH("score_word", BENCH_GUESSES * BENCH_WORDS, BENCH_GUESSES * BENCH_WORDS * sizeof(word_t), {
+		for (i = 0; i < BENCH_GUESSES; ++i) {
+			for (j = 0; j < BENCH_WORDS; ++j) {
+				want[j] = score.word(d.words[j], packed[i]);
+			}
+		}
+	});
+	BENCH("score_batch", BENCH_GUESSES * BENCH_WORDS, BENCH_GUESSES * BENCH_WORDS * sizeof(word_t), {
+		for (i = 0; i < BENCH_GUESSES; ++i) {
+			score.batch(packed[i], d.words, BENCH_WORDS, pat);
+		}
+	});
+	/* the last guess is left in both */
+	if (memcmp(pat, want, BENCH_WORDS * sizeof(*pat))) {
+		fprintf(stderr, "score_batch disagrees with score_word\n");
+		return 1;
+	}
+	/* the byte kernel the matrix uses at this length */
+	pat8 = xcalloc(BENCH_WORDS, sizeof(*pat8));
+	BENCH("score_batch8", BENCH_GUESSES * BENCH_WORDS, BENCH_GUESSES * BENCH_WORDS * sizeof(word_t), {
+		for (i = 0; i < BENCH_GUESSES; ++i) {
+			score.batch8(packed[i], d.words, BENCH_WORDS, pat8);
+		}
+	});
+	for (j = 0; j < BENCH_WORDS; ++j) {
+		if (pat8[j] != want[j]) {
+			fprintf(stderr, "score_batch8 disagrees with score_word\n");
+			return 1;
+		}
+	}
+	free(pat8);
+
+	/* two rows in, as hard mode would be checking them */
+	hard_init(&rules, BENCH_LEN);
+	hard_add(&rules, packed[0], score.word(d.words[1], packed[0]));
+	hard_add(&rules, packed[1], score.word(d.words[1], packed[1]));
+	kept = xcalloc(BENCH_WORDS, sizeof(*kept));
+	BENCH("hard_filter", BENCH_WORDS, BENCH_WORDS * sizeof(word_t), {
+		memcpy(kept, d.words, BENCH_WORDS * sizeof(*kept));
+		found = hard_filter(&rules, kept, BENCH_WORDS);
+	});
+	if (!found || found == BENCH_WORDS) {
+		fprintf(stderr, "hard_filter kept %zu of %d\n", found, BENCH_WORDS);
+		return 1;
+	}
+	free(kept);
+
+	/* the kernel for every other length, on words of that length */
+	packed = xreallocarray(packed, BENCH_WORDS, sizeof(*packed));
+	for (len = WORD_LEN_MIN; len <= WORD_LEN_MAX; ++len) {
+		if (len == BENCH_LEN)
+			continue;
+		for (i = 0; i < BENCH_WORDS; ++i) {
+			packed[i] = 0;
+			for (j = 0; j < (size_t)len; ++j) {
+				packed[i] |= (word_t)rnd_pcg_range(&pcg, 1, 26) << (j * LETTER_BITS);
+			}
+		}
+		scorer_init(&score, len);
+		snprintf(name, sizeof(name), "score_batch (%d letters)", len);
+		BENCH(name, BENCH_GUESSES * BENCH_WORDS, BENCH_GUESSES * BENCH_WORDS * sizeof(word_t), {
+			for (i = 0; i < BENCH_GUESSES; ++i) {
+				score.batch(packed[i], packed, BENCH_WORDS, pat);
+			}
+		});
+	}
+	scorer_init(&score, BENCH_LEN);
+
+	for (i = 0; i < RND_PCG8_LANES; ++i) {
+		seeds[i] = i + 1;
+	}
+	rnd_pcg8_seed(&pcg8, seeds);
+	rnd_well_seed(&well, 1);
+	rnd_gamerand_seed(&gamerand, 1);
+	rnd_xorshift_seed(&xorshift, 1);
+	BENCH("rnd_pcg_next", BENCH_RND, BENCH_RND * sizeof(RND_U32), {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_pcg_next(&pcg);
+		}
+	});
+	BENCH("rnd_pcg_range", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_pcg_range(&pcg, 0, BENCH_WORDS - 1);
+		}
+	});
+	BENCH("rnd_pcg_bounded", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_pcg_bounded(&pcg, BENCH_WORDS);
+		}
+	});
+	BENCH("rnd_pcg_bounded64", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_pcg_bounded64(&pcg, 3ull << 40);
+		}
+	});
+	BENCH("rnd_pcg_advance", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			rnd_pcg_advance(&pcg, i << 32);
+		}
+	});
+	BENCH("rnd_pcg8_fill", BENCH_RND, BENCH_RND * sizeof(RND_U32), {
+		for (i = 0; i < BENCH_RND; i += BENCH_FILL) {
+			rnd_pcg8_fill(&pcg8, fill, BENCH_FILL);
+			sink += fill[i % BENCH_FILL];
+		}
+	});
+	BENCH("rnd_pcg8_fill_bounded", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; i += BENCH_FILL) {
+			rnd_pcg8_fill_bounded(&pcg8, fill, BENCH_FILL, BENCH_WORDS);
+			sink += fill[i % BENCH_FILL];
+		}
+	});
+	BENCH("rnd_pcg_nextf", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_pcg_nextf(&pcg) * 2;
+		}
+	});
+	BENCH("rnd_well_next", BENCH_RND, BENCH_RND * sizeof(RND_U32), {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_well_next(&well);
+		}
+	});
+	BENCH("rnd_well_range", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_well_range(&well, 0, BENCH_WORDS - 1);
+		}
+	});
+	BENCH("rnd_gamerand_next", BENCH_RND, BENCH_RND * sizeof(RND_U32), {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_gamerand_next(&gamerand);
+		}
+	});
+	BENCH("rnd_gamerand_range", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_gamerand_range(&gamerand, 0, BENCH_WORDS - 1);
+		}
+	});
+	BENCH("rnd_xorshift_next", BENCH_RND, BENCH_RND * sizeof(RND_U64), {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_xorshift_next(&xorshift);
+		}
+	});
+	BENCH("rnd_xorshift_range", BENCH_RND, 0, {
+		for (i = 0; i < BENCH_RND; ++i) {
+			sink += rnd_xorshift_range(&xorshift, 0, BENCH_WORDS - 1);
+		}
+	});
+
+	xasprintf(&path, "%s/stat", tmpdir);
+	if ((fd = open_game_stat(path)) == -1) {
+		perror("open stats");
+		return 1;
+	}
+	store_game_stat(fd, gs, ROW_DEFAULT);
+	BENCH("stats load", 1, gs_size, load_game_stat(fd, gs, ROW_DEFAULT));
+	BENCH("stats store", 1, gs_size, store_game_stat(fd, gs, ROW_DEFAULT));
+	close_game_stat(fd);
+	/* a whole sync, as at the end of every game */
+	BENCH("stats sync", 1, gs_size * 2, {
+		xasprintf(&path, "%s/stat", tmpdir);
+		fd = open_game_stat(path);
+		load_game_stat(fd, gs, ROW_DEFAULT);
+		++gs[0];
+		gs[GAMESTAT_SUM(ROW_DEFAULT)] = sum_game_stat(gs, ROW_DEFAULT);
+		store_game_stat(fd, gs, ROW_DEFAULT);
+		close_game_stat(fd);
+	});
+
+	/* a full matrix of the synthetic list would be far too big */
+	memset(&sub, 0, sizeof(sub));
+	sub.len = BENCH_LEN;
+	sub.words = d.words;
+	sub.count = BENCH_MATRIX_WORDS;
+	t = now();
+	if (matrix_open(&m, &sub, tmpdir, 0) == -1) {
+		perror("matrix_open");
+		return 1;
+	}
+	report("matrix build (per pair)", now() - t, (size_t)BENCH_MATRIX_WORDS * BENCH_MATRIX_WORDS,
+			(size_t)BENCH_MATRIX_WORDS * BENCH_MATRIX_WORDS * m.pattern_size);
+	matrix_free(&m);
+	t = now();
+	matrix_open(&m, &sub, tmpdir, 0);
+	printf("%-24s %12.3f ms (%d words)\n", "matrix load", (now() - t) * 1e3, BENCH_MATRIX_WORDS);
+	if (matrix_get(&m, 7, 11) != score.word(sub.words[11], sub.words[7])) {
+		fprintf(stderr, "matrix disagrees with score_word\n");
+		return 1;
+	}
+	matrix_free(&m);
+
+	op = xcalloc(BENCH_MATRIX_WORDS, sizeof(*op));
+	for (i = 0; i < BENCH_MATRIX_WORDS; ++i) {
+		op[i].word = sub.words[i];
+		op[i].answer = true;
+	}
+	t = now();
+	opener_rank(&sub, op, BENCH_MATRIX_WORDS, 0);
+	report("opener_rank (per pair)", now() - t, (size_t)BENCH_MATRIX_WORDS * BENCH_MATRIX_WORDS, 0);
+	free(op);
+	remove_dir(tmpdir);
+	free(probe);
+	free(words);
+	xarena_free(&arena);
+	(void)sink;
+	return 0;
+}
@@ -0,0 +1,348 @@
+/* dawg -- minimized word graph for cordl's membership tests
+ *
+ * The words of a dict as a directed acyclic word graph: a trie with every
+ * set of identical subtrees stored once, so common endings are shared as
+ * well as common beginnings. It is a flat array of 32-bit cells. A node is
+ * a cell with a bit set for each letter it has an edge for, followed by the
+ * index of the node each of those leads to, in letter order, so following
+ * a letter is a popcount away. Since a dict's words are all one length,
+ * every path of len edges from the root spells a word, and the nodes for
+ * the last letter, where every edge ends a word, are marked DAWG_LEAF and
+ * have no indices at all. Cell 0 is never used.
+ *
+ * Holding no pointers, it is cached as is in a .cordldawg file, a header
+ * followed by the cells, named after and checked against dict_hash(), and
+ * shared between processes by mapping it.
+*/
+#pragma once
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sassert.h"
+#include "xmem.h"
+#include "dict.h"
+
+#define DAWG_MAGIC "CORDLDWG"
+#define DAWG_VERSION 1
+
+/* cells that can be indexed */
+#define DAWG_CELLS_MAX UINT32_MAX
+/* in a node's first cell, above the letters: no indices follow */
+#define DAWG_LEAF (1u << 26)
+
+struct dawg_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t word_len;
+	uint32_t root;
+	uint32_t pad;
+	uint64_t words;
+	uint64_t cells;
+	uint64_t dict_hash;
+	char reserved[16];
+};
+
+static_assert(sizeof(struct dawg_header) == 64, "DAWG header should keep the cells aligned");
+
+struct dawg {
+	int len;
+	size_t words;
+	uint32_t root;
+	const uint32_t *cells;
+	size_t count;
+	/* the cells are either mapped from the cache or allocated */
+	void *map;
+	size_t map_len;
+	uint32_t *alloc;
+};
+
+/* node de-duplication while building, by the cells they hold */
+struct dawg_build {
+	int len;
+	uint32_t *cells;
+	size_t count, cap;
+	uint32_t *nodes;
+	size_t nodes_mask, node_count;
+};
+
+static int dawg_popcount(uint32_t x)
+{
+#ifdef __GNUC__
+	return __builtin_popcount(x);
+#else
+	int n;
+	for (n = 0; x; ++n) {
+		x &= x - 1;
+	}
+	return n;
+#endif
+}
+
+/* cells in the node starting with cell c */
+#define dawg_node_len(c) ((c) & DAWG_LEAF ? 1 : 1 + (size_t)dawg_popcount(c))
+
+static size_t dawg_node_hash(const uint32_t *c, size_t n)
+{
+	uint64_t h = n;
+
+	while (n--) {
+		h = (h ^ *c++) * 0x9e3779b97f4a7c15ull;
+	}
+	return h ^ (h >> 29);
+}
+
+/* Add the node at c, which need not be in b->cells yet, unless there is one
+ * just like it already; either way, return its index. 0 if the graph has
+ * outgrown DAWG_CELLS_MAX. */
+static uint32_t dawg_node_add(struct dawg_build *b, const uint32_t *c)
+{
+	size_t n = dawg_node_len(*c);
+	size_t h, i;
+	uint32_t *old;
+
+	if (b->node_count * 2 >= b->nodes_mask + 1) {
+		old = b->nodes;
+		b->nodes = xcalloc((b->nodes_mask + 1) * 2, sizeof(*b->nodes));
+		for (i = 0; i <= b->nodes_mask; ++i) {
+			if (!old[i])
+				continue;
+			h = dawg_node_hash(b->cells + old[i], dawg_node_len(b->cells[old[i]]));
+			for (h &= b->nodes_mask * 2 + 1; b->nodes[h]; h = (h + 1) & (b->nodes_mask * 2 + 1));
+			b->nodes[h] = old[i];
+		}
+		b->nodes_mask = b->nodes_mask * 2 + 1;
+		free(old);
+	}
+
+	for (h = dawg_node_hash(c, n) & b->nodes_mask; b->nodes[h]; h = (h + 1) & b->nodes_mask) {
+		if (b->cells[b->nodes[h]] == *c && !memcmp(b->cells + b->nodes[h], c, n * sizeof(*c)))
+			return b->nodes[h];
+	}
+	if (b->count + n > DAWG_CELLS_MAX)
+		return 0;
+	if (b->count + n > b->cap) {
+		b->cap = (b->count + n) * 2;
+		b->cells = xreallocarray(b->cells, b->cap, sizeof(*b->cells));
+	}
+	memcpy(b->cells + b->count, c, n * sizeof(*c));
+	b->nodes[h] = b->count;
+	b->count += n;
+	++b->node_count;
+	return b->nodes[h];
+}
+
+/* Build the node for keys[lo, hi), which agree up to letter depth, bottom
+ * up; 0 if the graph got too big. Keys hold the first letter highest, so
+ * they sort in word order. */
+static uint32_t dawg_build_node(struct dawg_build *b, const uint64_t *keys, size_t lo, size_t hi, int depth)
+{
+	uint32_t c[1 + 26] = {0};
+	int shift = (b->len - 1 - depth) * LETTER_BITS;
+	size_t end, n = 1;
+	unsigned l;
+
+	if (depth == b->len - 1) {
+		c[0] = DAWG_LEAF;
+	}
+	while (lo < hi) {
+		l = (keys[lo] >> shift) & LETTER_MASK;
+		for (end = lo + 1; end < hi && ((keys[end] >> shift) & LETTER_MASK) == l; ++end);
+		c[0] |= 1u << (l - 1);
+		if (!(c[0] & DAWG_LEAF) && !(c[n++] = dawg_build_node(b, keys, lo, end, depth + 1)))
+			return 0;
+		lo = end;
+	}
+	return dawg_node_add(b, c);
+}
+
+static int dawg_key_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* build the graph of d's words into g; -1 with errno set if it won't fit */
+static int dawg_build(struct dawg *g, const struct dict *d)
+{
+	struct dawg_build b;
+	uint64_t *keys;
+	size_t i;
+	int j;
+
+	memset(g, 0, sizeof(*g));
+	g->len = d->len;
+	g->words = d->count;
+	memset(&b, 0, sizeof(b));
+	b.len = d->len;
+	b.cap = d->count + 1;
+	b.count = 1;
+	b.cells = xcalloc(b.cap, sizeof(*b.cells));
+	b.nodes_mask = 1023;
+	b.nodes = xcalloc(b.nodes_mask + 1, sizeof(*b.nodes));
+
+	keys = xcalloc(d->count ? d->count : 1, sizeof(*keys));
+	for (i = 0; i < d->count; ++i) {
+		for (j = 0; j < d->len; ++j) {
+			keys[i] = keys[i] << LETTER_BITS | (word_letter(d->words[i], j) + 1);
+		}
+	}
+	qsort(keys, d->count, sizeof(*keys), dawg_key_cmp);
+	if (d->count && !(g->root = dawg_build_node(&b, keys, 0, d->count, 0))) {
+		free(keys);
+		free(b.nodes);
+		free(b.cells);
+		errno = EFBIG;
+		return -1;
+	}
+	free(keys);
+	free(b.nodes);
+
+	g->alloc = xreallocarray(b.cells, b.count, sizeof(*b.cells));
+	g->cells = g->alloc;
+	g->count = b.count;
+	return 0;
+}
+
+static void dawg_header_init(struct dawg_header *h, const struct dawg *g, uint64_t hash)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, DAWG_MAGIC, sizeof(h->magic));
+	h->version = DAWG_VERSION;
+	h->word_len = g->len;
+	h->root = g->root;
+	h->words = g->words;
+	h->cells = g->count;
+	h->dict_hash = hash;
+}
+
+/* map the graph at path, if it was built from d, whose hash is hash */
+static bool dawg_load(struct dawg *g, const struct dict *d, uint64_t hash, const char *path)
+{
+	struct dawg_header h;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		return false;
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(h)) {
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	memcpy(&h, map, sizeof(h));
+	if (memcmp(h.magic, DAWG_MAGIC, sizeof(h.magic)) || h.version != DAWG_VERSION || h.word_len != (uint32_t)d->len
+			|| h.words != d->count || h.dict_hash != hash || h.cells > DAWG_CELLS_MAX || !h.root || h.root >= h.cells
+			|| (size_t)st.st_size != sizeof(h) + h.cells * sizeof(*g->cells)) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	memset(g, 0, sizeof(*g));
+	g->len = d->len;
+	g->words = d->count;
+	g->root = h.root;
+	g->count = h.cells;
+	g->cells = (const uint32_t *)((char *)map + sizeof(h));
+	g->map = map;
+	g->map_len = st.st_size;
+	return true;
+}
+
+/* Open the graph of d, mapping it from cache_dir if it's been built before,
+ * and building it (and caching it there) if not. Returns -1 with errno set
+ * on failure, which includes graphs over DAWG_CELLS_MAX cells. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int dawg_open(struct dawg *g, const struct dict *d, const char *cache_dir)
+{
+	struct dawg_header h;
+	uint64_t hash = dict_hash(d);
+	char *path = NULL, *tmp;
+	bool ok;
+	int fd;
+
+	if (cache_dir) {
+		xasprintf(&path, "%s/cordl_%016llx.cordldawg", cache_dir, (unsigned long long)hash);
+		if (dawg_load(g, d, hash, path)) {
+			free(path);
+			return 0;
+		}
+	}
+	if (dawg_build(g, d) == -1) {
+		free(path);
+		return -1;
+	}
+	if (path) {
+		dawg_header_init(&h, g, hash);
+		xasprintf(&tmp, "%s.%ld", path, (long)getpid());
+		if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) != -1) {
+			ok = dict_cache_write(fd, &h, sizeof(h))
+				&& dict_cache_write(fd, g->cells, g->count * sizeof(*g->cells));
+			if (close(fd) == -1 || !ok || rename(tmp, path) == -1) {
+				unlink(tmp);
+			}
+		}
+		free(tmp);
+		free(path);
+	}
+	return 0;
+}
+
+/* Whether w, a packed word of any length, is in the graph. Every index is
+ * checked against the cells, so a damaged cache can't lead outside them. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool dawg_contains(const struct dawg *g, word_t w)
+{
+	size_t node = g->root, next;
+	uint32_t c;
+	int i, l;
+
+	if (!g->words || (w >> (g->len * LETTER_BITS)))
+		return false;
+	for (i = 0; ; ++i) {
+		c = g->cells[node];
+		if ((l = word_letter(w, i)) < 0 || l >= 26 || !(c >> l & 1))
+			return false;
+		if (i == g->len - 1)
+			return true;
+		next = node + 1 + dawg_popcount(c & ((1u << l) - 1));
+		if (next >= g->count || (node = g->cells[next]) >= g->count)
+			return false;
+	}
+}
+
+/* bytes of cells, whether mapped or not */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static size_t dawg_bytes(const struct dawg *g)
+{
+	return g->count * sizeof(*g->cells);
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void dawg_free(struct dawg *g)
+{
+	if (g->map) {
+		munmap(g->map, g->map_len);
+	}
+	free(g->alloc);
+	memset(g, 0, sizeof(*g));
+}
@@ -0,0 +1,1089 @@
+/* dict -- packed dictionary storage and lookup for cordl
+ *
+ * Everything here is static, in the same manner as the other helper headers,
+ * so that both cordl and the benchmark can include it directly.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sassert.h"
+#include "xmem.h"
+#include "par.h"
+
+#ifdef ANCIENT
+#include "getline.h"
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DICT_X86
+#include <immintrin.h>
+#endif
+
+/* the word lengths that can be played */
+#define WORD_LEN_MIN 4
+#define WORD_LEN_MAX 8
+#define WORD_LEN_DEFAULT 5
+#define WORD_CHARSET "abcdefghijklmnopqrstuvwxyz"
+#define LETTER_BITS 5
+#define LETTER_MASK ((1u << LETTER_BITS) - 1)
+
+/* A word packed into an integer, LETTER_BITS per letter with the first
+ * letter in the low bits. Letters are stored as 1-26 rather than 0-25 so that
+ * no word ever packs to zero, which is then free to mean "no word", and so
+ * that the letters past the end of a shorter word are all zero. */
+typedef uint64_t word_t;
+
+static_assert(WORD_LEN_MAX * LETTER_BITS <= sizeof(word_t) * 8, "Word does not fit in word_t");
+
+/* pack the len chars at s, returning 0 unless they are WORD_LEN_MIN to
+ * WORD_LEN_MAX letters of a-z. This doubles as the dictionary's validation. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static word_t word_pack_n(const char *s, size_t len)
+{
+	word_t w = 0;
+	size_t i;
+	if (len < WORD_LEN_MIN || len > WORD_LEN_MAX)
+		return 0;
+	for (i = 0; i < len; ++i) {
+		if (s[i] < 'a' || s[i] > 'z')
+			return 0;
+		w |= (word_t)(s[i] - 'a' + 1) << (i * LETTER_BITS);
+	}
+	return w;
+}
+
+/* as above, for a NUL-terminated string */
+#define word_pack(s) word_pack_n((s), strlen(s))
+
+/* letter i of w, as an offset into a-z */
+#define word_letter(w, i) ((int)(((w) >> ((i) * LETTER_BITS)) & LETTER_MASK) - 1)
+
+/* unpack w into buf, which must hold WORD_LEN_MAX + 1 chars */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static char *word_unpack(word_t w, char *buf)
+{
+	int i;
+	for (i = 0; i < WORD_LEN_MAX && word_letter(w, i) >= 0; ++i) {
+		buf[i] = 'a' + word_letter(w, i);
+	}
+	buf[i] = '\0';
+	return buf;
+}
+
+/* A dictionary of words of length len: the packed words in file order, and
+ * an open-addressing (linear probing) hash set of the same words for
+ * membership tests. Empty set slots are zero. The set is kept at most half
+ * full, so probe sequences stay short. */
+struct dict {
+	int len;
+	word_t *words;
+	size_t count;
+	word_t *set;
+	size_t mask;
+};
+
+/* Every usable word of a dictionary file, one dict per length. Only the
+ * WORD_LEN_MIN to WORD_LEN_MAX entries are used.
+ *
+ * When loaded from an index cache, the words and sets point into map rather
+ * than being allocated. */
+struct lexicon {
+	struct dict by_len[WORD_LEN_MAX + 1];
+	void *map;
+	size_t map_len;
+};
+
+static size_t word_hash(word_t w)
+{
+	uint64_t h = w * 0x9e3779b97f4a7c15ull;
+	return h ^ (h >> 29);
+}
+
+/* Build the hash set for d. Later copies of a word are dropped from the
+ * word array as they turn up, so it stays in file order without them. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void dict_index_build(struct dict *d)
+{
+	size_t size = 16;
+	size_t i, h, n = 0;
+
+	while (size < d->count * 2) {
+		size <<= 1;
+	}
+	d->mask = size - 1;
+	d->set = xcalloc(size, sizeof(*d->set));
+
+	for (i = 0; i < d->count; ++i) {
+		h = word_hash(d->words[i]) & d->mask;
+		while (d->set[h] && d->set[h] != d->words[i]) {
+			h = (h + 1) & d->mask;
+		}
+		if (!d->set[h]) {
+			d->set[h] = d->words[n++] = d->words[i];
+		}
+	}
+	d->count = n;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool dict_contains(const struct dict *d, word_t w)
+{
+	size_t h = word_hash(w) & d->mask;
+
+	if (!w)
+		return false;
+	while (d->set[h]) {
+		if (d->set[h] == w)
+			return true;
+		h = (h + 1) & d->mask;
+	}
+	return false;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void dict_free(struct dict *d)
+{
+	free(d->words);
+	free(d->set);
+	memset(d, 0, sizeof(*d));
+}
+
+/* A set of words of one length, for checking guesses without keeping a list
+ * of them. While every possible word fits in WORD_SET_BITMAP_MAX bits, it is
+ * one bit per possible word, indexed by the letters read as a number in base
+ * 26 (four and five letters, at 57 KiB and 1.5 MiB). Past that it is a hash
+ * set like dict's, grown as words are added. */
+#define WORD_SET_BITMAP_MAX (1ull << 27)
+
+struct word_set {
+	int len;
+	size_t count;
+	/* the bitmap, or NULL */
+	uint64_t *bits;
+	word_t *set;
+	size_t mask;
+};
+
+/* how many words of len letters there could be */
+static uint64_t word_space(int len)
+{
+	uint64_t space = 1;
+
+	while (len--) {
+		space *= 26;
+	}
+	return space;
+}
+
+/* w as a number in base 26, for indexing the bitmap */
+static uint64_t word_rank(word_t w, int len)
+{
+	uint64_t r = 0;
+	int i;
+
+	for (i = len - 1; i >= 0; --i) {
+		r = r * 26 + word_letter(w, i);
+	}
+	return r;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void word_set_init(struct word_set *ws, int len)
+{
+	memset(ws, 0, sizeof(*ws));
+	ws->len = len;
+	if (word_space(len) <= WORD_SET_BITMAP_MAX) {
+		ws->bits = xcalloc((word_space(len) + 63) / 64, sizeof(*ws->bits));
+	} else {
+		ws->mask = 1023;
+		ws->set = xcalloc(ws->mask + 1, sizeof(*ws->set));
+	}
+}
+
+/* slot of w in the hash set: where it is, or the empty one it would go in */
+static size_t word_set_slot(const struct word_set *ws, word_t w)
+{
+	size_t h = word_hash(w) & ws->mask;
+
+	while (ws->set[h] && ws->set[h] != w) {
+		h = (h + 1) & ws->mask;
+	}
+	return h;
+}
+
+/* double the hash set, keeping it at most half full */
+static void word_set_grow(struct word_set *ws)
+{
+	word_t *old = ws->set;
+	size_t i, size = ws->mask + 1;
+
+	ws->mask = size * 2 - 1;
+	ws->set = xcalloc(size * 2, sizeof(*ws->set));
+	for (i = 0; i < size; ++i) {
+		if (old[i]) {
+			ws->set[word_set_slot(ws, old[i])] = old[i];
+		}
+	}
+	free(old);
+}
+
+/* add w, a word of ws->len letters; returns false if it was already there */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool word_set_add(struct word_set *ws, word_t w)
+{
+	uint64_t r, bit;
+	size_t h;
+
+	if (ws->bits) {
+		r = word_rank(w, ws->len);
+		bit = 1ull << (r % 64);
+		if (ws->bits[r / 64] & bit)
+			return false;
+		ws->bits[r / 64] |= bit;
+	} else {
+		if ((ws->count + 1) * 2 > ws->mask + 1) {
+			word_set_grow(ws);
+		}
+		h = word_set_slot(ws, w);
+		if (ws->set[h])
+			return false;
+		ws->set[h] = w;
+	}
+	++ws->count;
+	return true;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool word_set_contains(const struct word_set *ws, word_t w)
+{
+	uint64_t r;
+
+	if (!w || word_letter(w, ws->len - 1) < 0 || (ws->len < WORD_LEN_MAX && word_letter(w, ws->len) >= 0))
+		return false;
+	if (ws->bits) {
+		r = word_rank(w, ws->len);
+		return ws->bits[r / 64] >> (r % 64) & 1;
+	}
+	return ws->set[word_set_slot(ws, w)] == w;
+}
+
+/* bytes held by ws */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static size_t word_set_bytes(const struct word_set *ws)
+{
+	if (!ws->bits)
+		return (ws->mask + 1) * sizeof(*ws->set);
+	return (word_space(ws->len) + 63) / 64 * sizeof(*ws->bits);
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void word_set_free(struct word_set *ws)
+{
+	free(ws->bits);
+	free(ws->set);
+	memset(ws, 0, sizeof(*ws));
+}
+
+/* A split block Bloom filter over packed words, for turning away most
+ * non-words before looking in a big dictionary. Each word sets one bit in
+ * each of the BLOOM_LANES 64-bit lanes of a single 64 byte block, so a test
+ * touches one cache line. With at least BLOOM_BITS_PER_WORD bits a word,
+ * under 0.5% of non-words get through. */
+#define BLOOM_BITS_PER_WORD 12
+#define BLOOM_LANES 8
+
+struct bloom {
+	/* blocks of BLOOM_LANES, cache line aligned within alloc */
+	uint64_t *bits;
+	size_t mask;
+	void *alloc;
+	/* whether every bit h picks out of block is set */
+	bool (*test)(const uint64_t *block, uint64_t h);
+};
+
+/* which block w goes in, and its bit in each lane, six bits a lane */
+#define bloom_block(b, w) ((b)->bits + ((word_hash(w) >> 32) & (b)->mask) * BLOOM_LANES)
+#define bloom_lanes(w) (((w) ^ ((w) >> 23)) * 0xd6e8feb86659fd93ull)
+
+static bool bloom_test(const uint64_t *block, uint64_t h)
+{
+	uint64_t miss = 0;
+	int i;
+
+	/* no early out, as the whole line is loaded anyway */
+	for (i = 0; i < BLOOM_LANES; ++i) {
+		miss |= ~block[i] & (1ull << ((h >> (i * 6)) & 63));
+	}
+	return !miss;
+}
+
+#ifdef DICT_X86
+/* four lanes to a register, shifting each by its own six bits of h */
+__attribute__((target("avx2")))
+static bool bloom_test_avx2(const uint64_t *block, uint64_t h)
+{
+	const __m256i one = _mm256_set1_epi64x(1), low6 = _mm256_set1_epi64x(63);
+	__m256i hv = _mm256_set1_epi64x(h);
+	__m256i lo = _mm256_and_si256(_mm256_srlv_epi64(hv, _mm256_setr_epi64x(0, 6, 12, 18)), low6);
+	__m256i hi = _mm256_and_si256(_mm256_srlv_epi64(hv, _mm256_setr_epi64x(24, 30, 36, 42)), low6);
+
+	return _mm256_testc_si256(_mm256_load_si256((const __m256i *)block), _mm256_sllv_epi64(one, lo)) &
+		_mm256_testc_si256(_mm256_load_si256((const __m256i *)block + 1), _mm256_sllv_epi64(one, hi));
+}
+#endif
+
+/* an empty filter sized for n words */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void bloom_init(struct bloom *b, size_t n)
+{
+	size_t blocks = 1;
+
+	while (blocks * BLOOM_LANES * 64 < n * BLOOM_BITS_PER_WORD) {
+		blocks <<= 1;
+	}
+	b->mask = blocks - 1;
+	b->alloc = xcalloc(blocks + 1, BLOOM_LANES * sizeof(*b->bits));
+	b->bits = (uint64_t *)(((uintptr_t)b->alloc + 63) & ~(uintptr_t)63);
+	b->test = bloom_test;
+#ifdef DICT_X86
+	if (__builtin_cpu_supports("avx2")) {
+		b->test = bloom_test_avx2;
+	}
+#endif
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void bloom_add(struct bloom *b, word_t w)
+{
+	uint64_t *block = bloom_block(b, w), h = bloom_lanes(w);
+	int i;
+
+	for (i = 0; i < BLOOM_LANES; ++i) {
+		block[i] |= 1ull << ((h >> (i * 6)) & 63);
+	}
+}
+
+/* false if w was never added; true if it probably was */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool bloom_maybe(const struct bloom *b, word_t w)
+{
+	return b->test(bloom_block(b, w), bloom_lanes(w));
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static size_t bloom_bytes(const struct bloom *b)
+{
+	return (b->mask + 1) * BLOOM_LANES * sizeof(*b->bits);
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void bloom_free(struct bloom *b)
+{
+	free(b->alloc);
+	memset(b, 0, sizeof(*b));
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void lexicon_free(struct lexicon *lx)
+{
+	int len;
+
+	if (lx->map) {
+		munmap(lx->map, lx->map_len);
+	} else {
+		for (len = WORD_LEN_MIN; len <= WORD_LEN_MAX; ++len) {
+			dict_free(&lx->by_len[len]);
+		}
+	}
+	memset(lx, 0, sizeof(*lx));
+}
+
+/* start lx off empty */
+static void lexicon_init(struct lexicon *lx)
+{
+	int len;
+
+	memset(lx, 0, sizeof(*lx));
+	for (len = 0; len <= WORD_LEN_MAX; ++len) {
+		lx->by_len[len].len = len;
+	}
+}
+
+/* FNV-1a over the packed words, identifying a dictionary's contents */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static uint64_t dict_hash(const struct dict *d)
+{
+	const unsigned char *p = (const unsigned char *)d->words;
+	const unsigned char *end = p + d->count * sizeof(*d->words);
+	uint64_t h = 14695981039346656037ull;
+
+	while (p < end) {
+		h ^= *p++;
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+/* append w to d, growing the array by half when it is full */
+static void dict_push(struct dict *d, size_t *cap, word_t w)
+{
+	if (d->count == *cap) {
+		*cap = *cap < 16 ? 24 : *cap + *cap / 2;
+		d->words = xreallocarray(d->words, *cap, sizeof(*d->words));
+	}
+	d->words[d->count++] = w;
+}
+
+/* trim the word array down to what was actually used */
+static void dict_shrink(struct dict *d)
+{
+	d->words = xreallocarray(d->words, d->count ? d->count : 1, sizeof(*d->words));
+}
+
+/* Ingest. Lines are found a block at a time, and most are then rejected
+ * on length alone. What is left is case folded through dict_fold, with a
+ * vector check that every byte is a letter letting the common case pack
+ * without a branch per byte. Lines that fail that check (accents, or the
+ * odd apostrophe) get a careful second look in dict_pack_fold(). */
+
+/* the letter (1-26) each byte stands for, either case, or 0 */
+#define DICT_FOLD(c) [c] = c - 'a' + 1, [c - 'a' + 'A'] = c - 'a' + 1
+static const uint8_t dict_fold[256] = {
+	DICT_FOLD('a'), DICT_FOLD('b'), DICT_FOLD('c'), DICT_FOLD('d'), DICT_FOLD('e'),
+	DICT_FOLD('f'), DICT_FOLD('g'), DICT_FOLD('h'), DICT_FOLD('i'), DICT_FOLD('j'),
+	DICT_FOLD('k'), DICT_FOLD('l'), DICT_FOLD('m'), DICT_FOLD('n'), DICT_FOLD('o'),
+	DICT_FOLD('p'), DICT_FOLD('q'), DICT_FOLD('r'), DICT_FOLD('s'), DICT_FOLD('t'),
+	DICT_FOLD('u'), DICT_FOLD('v'), DICT_FOLD('w'), DICT_FOLD('x'), DICT_FOLD('y'),
+	DICT_FOLD('z'),
+};
+#undef DICT_FOLD
+
+/* U+00C0 to U+00FF, UTF-8 0xc3 0x80 to 0xbf, without their accents. Those
+ * that aren't one plain letter (æ, ß, þ, ×, ÷) are 0. */
+static const char dict_fold_latin1[64] =
+	"aaaaaa\0ceeeeiiii" "dnooooo\0ouuuuy\0\0"
+	"aaaaaa\0ceeeeiiii" "dnooooo\0ouuuuy\0y";
+
+/* a line at most this long could still be a word, all of it accented */
+#define DICT_LINE_MAX (WORD_LEN_MAX * 2)
+
+/* pack the n bytes at s with case and accents folded, storing the length in
+ * letters in *len; 0 unless that comes to WORD_LEN_MIN to WORD_LEN_MAX
+ * letters */
+static word_t dict_pack_fold(const char *s, size_t n, int *len)
+{
+	const unsigned char *p = (const unsigned char *)s, *end = p + n;
+	word_t w = 0;
+	int i = 0, l;
+
+	while (p < end) {
+		if (*p == 0xc3 && p + 1 < end && p[1] >= 0x80 && p[1] < 0xc0) {
+			l = dict_fold_latin1[p[1] - 0x80];
+			l = l ? l - 'a' + 1 : 0;
+			p += 2;
+		} else {
+			l = dict_fold[*p++];
+		}
+		if (!l || i == WORD_LEN_MAX)
+			return 0;
+		w |= (word_t)l << (i++ * LETTER_BITS);
+	}
+	*len = i;
+	return i >= WORD_LEN_MIN ? w : 0;
+}
+
+/* Classify the 16 bytes at s: bit i of *letters is set if byte i is an
+ * ASCII letter, and of the result if it is not ASCII at all. */
+#ifdef DICT_X86
+__attribute__((target("sse2")))
+static unsigned dict_classify16(const char *s, unsigned *letters)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)s);
+	/* letters fold onto 0-25 after subtracting 'a', as unsigned bytes */
+	__m128i t = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	*letters = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(25)), t));
+	return _mm_movemask_epi8(v);
+}
+#else
+static unsigned dict_classify16(const char *s, unsigned *letters)
+{
+	unsigned high = 0;
+	int i;
+	*letters = 0;
+	for (i = 0; i < 16; ++i) {
+		*letters |= (unsigned)(dict_fold[(unsigned char)s[i]] != 0) << i;
+		high |= (unsigned)((unsigned char)s[i] >= 0x80) << i;
+	}
+	return high;
+}
+#endif
+
+/* pack the n (at most 8) ASCII letters at s, which has 8 bytes readable */
+#ifdef DICT_X86
+static word_t dict_pack8(const char *s, size_t n)
+{
+	uint64_t x;
+
+	/* x86 is little-endian, so byte i lands in bits 8i to 8i+7 */
+	memcpy(&x, s, sizeof(x));
+	/* fold case, take 'a' to 1, and drop the bytes past the word */
+	x = ((x | 0x2020202020202020ull) - 0x6060606060606060ull) & (~0ull >> (64 - n * 8));
+	/* squeeze the five bit letters together, halving the gaps each step */
+	x = (x & 0x001f001f001f001full) | ((x & 0x1f001f001f001f00ull) >> 3);
+	x = (x & 0x000003ff000003ffull) | ((x & 0x03ff000003ff0000ull) >> 6);
+	x = (x & 0x00000000000fffffull) | ((x & 0x000fffff00000000ull) >> 12);
+	return x;
+}
+#else
+static word_t dict_pack8(const char *s, size_t n)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	word_t w = 0;
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		w |= (word_t)dict_fold[p[i]] << (i * LETTER_BITS);
+	}
+	return w;
+}
+#endif
+
+/* add the line of n bytes at s, which has at least 16 bytes readable from it
+ * if fast is set */
+static void lexicon_add_line(struct lexicon *lx, size_t cap[static WORD_LEN_MAX + 1], const char *s, size_t n, bool fast)
+{
+	unsigned letters, high, want;
+	word_t w;
+	int len;
+
+	if (n && s[n - 1] == '\r') {
+		--n;
+	}
+	if (n < WORD_LEN_MIN || n > DICT_LINE_MAX)
+		return;
+	if (fast) {
+		high = dict_classify16(s, &letters);
+		want = (1u << n) - 1;
+		if ((letters & want) == want) {
+			if (n > WORD_LEN_MAX)
+				return;
+			dict_push(&lx->by_len[n], &cap[n], dict_pack8(s, n));
+			return;
+		}
+		/* only accents can still make a word of it */
+		if (!(high & want))
+			return;
+	}
+	if ((w = dict_pack_fold(s, n, &len))) {
+		dict_push(&lx->by_len[len], &cap[len], w);
+	}
+}
+
+/* bit i set where byte i of the 64 at p is a newline */
+#ifdef DICT_X86
+__attribute__((target("avx2")))
+static uint64_t dict_newlines_avx2(const char *p)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+	uint32_t lo = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), nl));
+	uint32_t hi = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), nl));
+	return (uint64_t)hi << 32 | lo;
+}
+
+__attribute__((target("sse2")))
+static uint64_t dict_newlines_sse2(const char *p)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+	uint64_t m = 0;
+	int i;
+	for (i = 0; i < 4; ++i) {
+		m |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i * 16)), nl)) << (i * 16);
+	}
+	return m;
+}
+#endif
+
+static uint64_t dict_newlines(const char *p)
+{
+	uint64_t m = 0;
+	int i;
+	for (i = 0; i < 64; ++i) {
+		m |= (uint64_t)(p[i] == '\n') << i;
+	}
+	return m;
+}
+
+static int dict_ctz64(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	int n;
+	for (n = 0; !(x & 1); ++n) {
+		x >>= 1;
+	}
+	return n;
+#endif
+}
+
+/* add every valid line of an in-memory buffer, without copying the lines
+ * out of it. The final line need not be newline-terminated. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void lexicon_load_buf(struct lexicon *lx, const char *buf, size_t len)
+{
+	uint64_t (*newlines)(const char *) = dict_newlines;
+	size_t cap[WORD_LEN_MAX + 1] = {0};
+	size_t base, start = 0, end;
+	uint64_t nl;
+	int n;
+
+#ifdef DICT_X86
+	if (__builtin_cpu_supports("avx2")) {
+		newlines = dict_newlines_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		newlines = dict_newlines_sse2;
+	}
+#endif
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		cap[n] = lx->by_len[n].count;
+	}
+	for (base = 0; base + 64 <= len; base += 64) {
+		for (nl = newlines(buf + base); nl; nl &= nl - 1) {
+			end = base + dict_ctz64(nl);
+			lexicon_add_line(lx, cap, buf + start, end - start, len - start >= 16);
+			start = end + 1;
+		}
+	}
+	/* the tail, too short for a block */
+	for (end = base; end < len; ++end) {
+		if (buf[end] == '\n') {
+			lexicon_add_line(lx, cap, buf + start, end - start, len - start >= 16);
+			start = end + 1;
+		}
+	}
+	if (start < len) {
+		lexicon_add_line(lx, cap, buf + start, len - start, len - start >= 16);
+	}
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		dict_shrink(&lx->by_len[n]);
+	}
+}
+
+/* Big buffers are split at newlines into chunks that are loaded on their
+ * own, in parallel, and then stitched back together in order. Duplicates
+ * across chunks are left to dict_index_build() like any others. */
+#define LEXICON_CHUNK_MIN (1 << 20)
+/* chunks per thread, so that uneven ones even out */
+#define LEXICON_CHUNKS_PER_THREAD 4
+
+struct lexicon_load_job {
+	const char *buf;
+	size_t len;
+	size_t chunk;
+	struct lexicon *part;
+};
+
+/* where chunk i starts: just past the first newline at or after i * chunk */
+static size_t lexicon_chunk_start(const struct lexicon_load_job *job, size_t i)
+{
+	size_t pos = i * job->chunk;
+	const char *nl;
+
+	if (!i)
+		return 0;
+	if (pos >= job->len)
+		return job->len;
+	nl = memchr(job->buf + pos - 1, '\n', job->len - pos + 1);
+	return nl ? (size_t)(nl - job->buf) + 1 : job->len;
+}
+
+static void lexicon_load_chunks(void *arg, size_t begin, size_t end)
+{
+	struct lexicon_load_job *job = arg;
+	size_t i, start;
+
+	for (i = begin; i < end; ++i) {
+		start = lexicon_chunk_start(job, i);
+		lexicon_init(&job->part[i]);
+		lexicon_load_buf(&job->part[i], job->buf + start, lexicon_chunk_start(job, i + 1) - start);
+	}
+}
+
+/* lexicon_load_buf() on up to threads threads (see par_for()), into an
+ * empty lx */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void lexicon_load_buf_par(struct lexicon *lx, const char *buf, size_t len, int threads)
+{
+	struct lexicon_load_job job;
+	size_t chunks, i, count;
+	struct dict *d;
+	int n;
+
+	if (threads <= 0) {
+		threads = par_threads();
+	}
+	chunks = len / LEXICON_CHUNK_MIN;
+	if (chunks > (size_t)threads * LEXICON_CHUNKS_PER_THREAD) {
+		chunks = (size_t)threads * LEXICON_CHUNKS_PER_THREAD;
+	}
+	if (threads == 1 || chunks <= 1) {
+		lexicon_load_buf(lx, buf, len);
+		return;
+	}
+
+	job.buf = buf;
+	job.len = len;
+	job.chunk = (len + chunks - 1) / chunks;
+	job.part = xcalloc(chunks, sizeof(*job.part));
+	par_for(chunks, 1, threads, lexicon_load_chunks, &job);
+
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		d = &lx->by_len[n];
+		for (i = count = 0; i < chunks; ++i) {
+			count += job.part[i].by_len[n].count;
+		}
+		d->words = xreallocarray(d->words, count ? count : 1, sizeof(*d->words));
+		for (i = 0; i < chunks; ++i) {
+			memcpy(d->words + d->count, job.part[i].by_len[n].words,
+					job.part[i].by_len[n].count * sizeof(*d->words));
+			d->count += job.part[i].by_len[n].count;
+		}
+	}
+	for (i = 0; i < chunks; ++i) {
+		lexicon_free(&job.part[i]);
+	}
+	free(job.part);
+}
+
+/* add every valid line read from f, for when it cannot be mapped */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void lexicon_load_stream(struct lexicon *lx, FILE *f)
+{
+	size_t cap[WORD_LEN_MAX + 1] = {0};
+	size_t n = 0;
+	ssize_t line_len;
+	char *line = NULL;
+	int len;
+
+	for (len = WORD_LEN_MIN; len <= WORD_LEN_MAX; ++len) {
+		cap[len] = lx->by_len[len].count;
+	}
+	while ((line_len = getline(&line, &n, f)) != -1) {
+		if (line[line_len - 1] == '\n') {
+			--line_len;
+		}
+		lexicon_add_line(lx, cap, line, line_len, false);
+	}
+	free(line);
+	for (len = WORD_LEN_MIN; len <= WORD_LEN_MAX; ++len) {
+		dict_shrink(&lx->by_len[len]);
+	}
+}
+
+/* load the dictionary at path into lx, mapping it when it is a regular file
+ * and streaming it otherwise (pipes, devices). Mapped files are loaded on
+ * up to threads threads (see par_for()). Returns -1 with errno set if it
+ * could not be opened. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int lexicon_load(struct lexicon *lx, const char *path, int threads)
+{
+	int fd;
+	struct stat st;
+	void *map;
+	FILE *f;
+
+	lexicon_init(lx);
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		return -1;
+	}
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+#ifdef POSIX_MADV_SEQUENTIAL
+			posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+			lexicon_load_buf_par(lx, map, st.st_size, threads);
+			munmap(map, st.st_size);
+			close(fd);
+			return 0;
+		}
+	}
+	if (!(f = fdopen(fd, "r"))) {
+		close(fd);
+		return -1;
+	}
+	lexicon_load_stream(lx, f);
+	fclose(f);
+	return 0;
+}
+
+/* The index cache (.cordlidx): a header identifying the source file and the
+ * packing, then the NUL-padded source path, and the word array and hash set
+ * of each length in turn, each starting on an 8 byte boundary. It is
+ * native-endian, and only ever read back by the machine that wrote it. */
+#define DICT_CACHE_MAGIC "CORDLIDX"
+#define DICT_CACHE_VERSION 3
+#define DICT_CACHE_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+struct dict_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t word_len_min;
+	uint32_t word_len_max;
+	uint32_t letter_bits;
+	uint32_t word_size;
+	uint32_t pad;
+	char charset[32];
+	uint64_t src_size;
+	int64_t src_mtime;
+	int64_t src_mtime_nsec;
+	uint64_t path_len;
+	/* indexed by length */
+	uint64_t count[WORD_LEN_MAX + 1];
+	uint64_t set_size[WORD_LEN_MAX + 1];
+};
+
+static_assert(sizeof(WORD_CHARSET) <= sizeof(((struct dict_cache_header *)0)->charset), "Charset too long for cache header");
+
+/* fill in everything a cache must match to be used for src */
+static void dict_cache_header_init(struct dict_cache_header *h, const char *src, const struct stat *st)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, DICT_CACHE_MAGIC, sizeof(h->magic));
+	h->version = DICT_CACHE_VERSION;
+	h->word_len_min = WORD_LEN_MIN;
+	h->word_len_max = WORD_LEN_MAX;
+	h->letter_bits = LETTER_BITS;
+	h->word_size = sizeof(word_t);
+	strcpy(h->charset, WORD_CHARSET);
+	h->src_size = st->st_size;
+	h->src_mtime = st->st_mtim.tv_sec;
+	h->src_mtime_nsec = st->st_mtim.tv_nsec;
+	h->path_len = strlen(src);
+}
+
+/* cache file for src inside dir, named after a hash of the source path */
+static char *dict_cache_path(const char *dir, const char *src)
+{
+	uint64_t h = 14695981039346656037ull;
+	char *path;
+
+	while (*src) {
+		h ^= (unsigned char)*src++;
+		h *= 1099511628211ull;
+	}
+	xasprintf(&path, "%s/cordl_%016llx.cordlidx", dir, (unsigned long long)h);
+	return path;
+}
+
+/* map cache and use it for lx if its header matches src; returns false if
+ * it is missing, stale or damaged */
+static bool dict_cache_load(struct lexicon *lx, const char *cache, const char *src, const struct stat *st)
+{
+	struct dict_cache_header want, *have;
+	struct stat cst;
+	size_t off[WORD_LEN_MAX + 1][2];
+	size_t pos, len;
+	struct dict *d;
+	void *map;
+	int fd, n;
+
+	if ((fd = open(cache, O_RDONLY)) == -1) {
+		return false;
+	}
+	if (fstat(fd, &cst) == -1 || cst.st_size < (off_t)sizeof(want)) {
+		close(fd);
+		return false;
+	}
+	len = cst.st_size;
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	dict_cache_header_init(&want, src, st);
+	have = map;
+	memcpy(want.count, have->count, sizeof(want.count));
+	memcpy(want.set_size, have->set_size, sizeof(want.set_size));
+	if (memcmp(have, &want, sizeof(want))
+			|| memcmp((char *)map + sizeof(want), src, want.path_len + 1)) {
+		munmap(map, len);
+		return false;
+	}
+	/* every section has to lie within the file, which has to end with the
+	 * last of them */
+	pos = DICT_CACHE_ALIGN(sizeof(want) + want.path_len + 1);
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		if (!have->set_size[n] || (have->set_size[n] & (have->set_size[n] - 1))
+				|| have->count[n] > (len - pos) / sizeof(word_t)) {
+			munmap(map, len);
+			return false;
+		}
+		off[n][0] = pos;
+		pos = DICT_CACHE_ALIGN(pos + have->count[n] * sizeof(word_t));
+		if (pos > len || have->set_size[n] > (len - pos) / sizeof(word_t)) {
+			munmap(map, len);
+			return false;
+		}
+		off[n][1] = pos;
+		pos += have->set_size[n] * sizeof(word_t);
+	}
+	if (pos != len) {
+		munmap(map, len);
+		return false;
+	}
+
+	lx->map = map;
+	lx->map_len = len;
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		d = &lx->by_len[n];
+		d->words = (word_t *)((char *)map + off[n][0]);
+		d->count = have->count[n];
+		d->set = (word_t *)((char *)map + off[n][1]);
+		d->mask = have->set_size[n] - 1;
+	}
+	return true;
+}
+
+static bool dict_cache_write(int fd, const void *buf, size_t len)
+{
+	ssize_t n;
+	while (len) {
+		if ((n = write(fd, buf, len)) <= 0)
+			return false;
+		buf = (const char *)buf + n;
+		len -= n;
+	}
+	return true;
+}
+
+/* write lx out as the cache for src. This goes through a temporary file and
+ * a rename, so a concurrent reader never sees a partial index. Failure is
+ * harmless; the next run simply rebuilds it. */
+static void dict_cache_store(const struct lexicon *lx, const char *cache, const char *src, const struct stat *st)
+{
+	struct dict_cache_header h;
+	static const char zero[8];
+	const struct dict *d;
+	char *tmp;
+	size_t off;
+	bool ok;
+	int fd, n;
+
+	dict_cache_header_init(&h, src, st);
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		h.count[n] = lx->by_len[n].count;
+		h.set_size[n] = lx->by_len[n].mask + 1;
+	}
+
+	xasprintf(&tmp, "%s.%ld", cache, (long)getpid());
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) {
+		free(tmp);
+		return;
+	}
+	off = sizeof(h) + h.path_len + 1;
+	ok = dict_cache_write(fd, &h, sizeof(h))
+		&& dict_cache_write(fd, src, h.path_len + 1)
+		&& dict_cache_write(fd, zero, DICT_CACHE_ALIGN(off) - off);
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX && ok; ++n) {
+		d = &lx->by_len[n];
+		off = d->count * sizeof(word_t);
+		ok = dict_cache_write(fd, d->words, off)
+			&& dict_cache_write(fd, zero, DICT_CACHE_ALIGN(off) - off)
+			&& dict_cache_write(fd, d->set, h.set_size[n] * sizeof(word_t));
+	}
+	if (close(fd) == -1 || !ok || rename(tmp, cache) == -1) {
+		unlink(tmp);
+	}
+	free(tmp);
+}
+
+/* Load path into lx on threads threads and build the index of every length,
+ * going through an index cache in cache_dir when that is non-NULL and path
+ * is a regular file. Picking a length afterwards is just a matter of taking
+ * its dict. Returns -1 with errno set if the dictionary could not be
+ * opened. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int lexicon_open(struct lexicon *lx, const char *path, const char *cache_dir, int threads)
+{
+	char src[PATH_MAX];
+	char *cache = NULL;
+	struct stat st;
+	size_t total = 0;
+	int n;
+
+	lexicon_init(lx);
+	if (cache_dir && stat(path, &st) == 0 && S_ISREG(st.st_mode) && realpath(path, src)) {
+		cache = dict_cache_path(cache_dir, src);
+		if (dict_cache_load(lx, cache, src, &st)) {
+			free(cache);
+			return 0;
+		}
+	}
+	if (lexicon_load(lx, path, threads) == -1) {
+		free(cache);
+		return -1;
+	}
+	for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+		dict_index_build(&lx->by_len[n]);
+		total += lx->by_len[n].count;
+	}
+	if (cache && total) {
+		dict_cache_store(lx, cache, src, &st);
+	}
+	free(cache);
+	return 0;
+}
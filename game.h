@@ -0,0 +1,70 @@
+/* game -- the state of one game of cordl
+ *
+ * Everything a game carries from row to row, so that a process can hold
+ * any number of them: the one being played on the terminal, or one per
+ * client of a server. The answer is 0 while only the other end knows it.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "dict.h"
+#include "score.h"
+#include "stats.h"
+#include "hard.h"
+
+struct game {
+	int len, rows;
+	word_t word;
+	/* rows played so far, and whether the last one won */
+	int row;
+	bool won;
+	/* each row as typed, with room for the one letter too many input takes */
+	char text[ROW_MAX][WORD_LEN_MAX + 2];
+	pattern_t pat[ROW_MAX];
+	/* what each letter was last found to be, as a pattern_digit + 1, 0 if
+	 * it hasn't been played */
+	uint8_t letter[26];
+	/* what hard mode allows next */
+	struct hard rules;
+};
+
+/* start a game of rows rows against word, of len letters */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void game_start(struct game *g, int len, int rows, word_t word)
+{
+	memset(g, 0, sizeof(*g));
+	g->len = len;
+	g->rows = rows;
+	g->word = word;
+	hard_init(&g->rules, len);
+}
+
+/* play guess as the next row, which got pattern p */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void game_add(struct game *g, word_t guess, pattern_t p)
+{
+	int i;
+
+	word_unpack(guess, g->text[g->row]);
+	g->pat[g->row] = p;
+	for (i = 0; i < g->len; ++i) {
+		g->letter[word_letter(guess, i)] = pattern_digit(p, i) + 1;
+	}
+	hard_add(&g->rules, guess, p);
+	g->won = p == pattern_count(g->len) - 1;
+	++g->row;
+}
+
+/* won, or out of rows */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool game_over(const struct game *g)
+{
+	return g->won || g->row == g->rows;
+}
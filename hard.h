@@ -0,0 +1,206 @@
+/* hard -- the hard mode rules for cordl
+ *
+ * Every row played narrows what the next may be: a letter found right stays
+ * where it is, no letter goes back where it was already tried, and every
+ * letter is used at least as often as it has been found, and no more often
+ * once a copy has been marked wrong. The rows are compiled into a struct
+ * hard as they are played, a mask of the letters allowed at each position
+ * and the bounds on each letter's count, so any word, even one half typed,
+ * is checked against all of them at once without going back over the rows.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "dict.h"
+#include "score.h"
+
+/* every letter, as a mask */
+#define HARD_LETTERS ((1u << 26) - 1)
+/* the most faults a word can have: one per position, and as many letters
+ * again with too many copies and with too few */
+#define HARD_FAULTS_MAX (WORD_LEN_MAX * 3)
+
+struct hard {
+	int len;
+	/* letters allowed at each position */
+	uint32_t allowed[WORD_LEN_MAX];
+	/* the letter found right at each position, or -1 */
+	int8_t right[WORD_LEN_MAX];
+	/* copies of each letter a word must have, at least and at most */
+	uint8_t min[26];
+	uint8_t max[26];
+	/* the letters whose count is bounded at all */
+	uint32_t counted;
+	int8_t bounded[26];
+	int bounds;
+};
+
+enum hard_rule {
+	/* a letter found right there was not kept */
+	HARD_MOVED,
+	/* the letter was already tried there */
+	HARD_TRIED,
+	/* more copies of the letter than there can be, none for a wrong one */
+	HARD_EXTRA,
+	/* fewer copies of the letter than were found, with no room for more */
+	HARD_MISSING,
+};
+
+struct hard_fault {
+	enum hard_rule rule;
+	int letter;
+	int pos;
+};
+
+/* no rows played yet, anything goes */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void hard_init(struct hard *h, int len)
+{
+	int i;
+
+	h->len = len;
+	for (i = 0; i < WORD_LEN_MAX; ++i) {
+		h->allowed[i] = HARD_LETTERS;
+		h->right[i] = -1;
+	}
+	memset(h->min, 0, sizeof(h->min));
+	memset(h->max, len, sizeof(h->max));
+	h->counted = 0;
+	h->bounds = 0;
+}
+
+/* add a row, guess and the pattern it got */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void hard_add(struct hard *h, word_t guess, pattern_t p)
+{
+	int found[26] = {0};
+	uint32_t wrong = 0;
+	int i, l;
+
+	for (i = 0; i < h->len; ++i) {
+		l = word_letter(guess, i);
+		switch (pattern_digit(p, i)) {
+			case PATTERN_RIGHT:
+				h->allowed[i] = 1u << l;
+				h->right[i] = l;
+				++found[l];
+				break;
+			case PATTERN_MISPLACED:
+				h->allowed[i] &= ~(1u << l);
+				++found[l];
+				break;
+			default:
+				h->allowed[i] &= ~(1u << l);
+				wrong |= 1u << l;
+				break;
+		}
+	}
+	for (l = 0; l < 26; ++l) {
+		if (found[l] > h->min[l]) {
+			h->min[l] = found[l];
+		}
+		if ((wrong >> l & 1) && found[l] < h->max[l]) {
+			h->max[l] = found[l];
+		}
+		if ((h->min[l] || h->max[l] < h->len) && !(h->counted >> l & 1)) {
+			h->counted |= 1u << l;
+			h->bounded[h->bounds++] = l;
+		}
+	}
+}
+
+/* Check the first n letters of s, lower case, storing up to max of the
+ * rules they break in fault; returns how many were stored. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int hard_check(const struct hard *h, const char *s, int n, struct hard_fault *fault, int max)
+{
+	int count[26] = {0};
+	int i, l, need = 0, faults = 0;
+
+#define HARD_FAULT(r, ll, p) do { \
+	if (faults < max) { \
+		fault[faults].rule = (r); \
+		fault[faults].letter = (ll); \
+		fault[faults].pos = (p); \
+		++faults; \
+	} \
+} while (0)
+	for (i = 0; i < n && i < h->len; ++i) {
+		l = s[i] - 'a';
+		++count[l];
+		if (h->allowed[i] >> l & 1)
+			continue;
+		if (h->right[i] >= 0) {
+			HARD_FAULT(HARD_MOVED, h->right[i], i);
+		} else if (h->max[l]) {
+			/* a letter that can't be used at all is reported once, below */
+			HARD_FAULT(HARD_TRIED, l, i);
+		}
+	}
+	for (l = 0; l < 26; ++l) {
+		if (count[l] > h->max[l]) {
+			HARD_FAULT(HARD_EXTRA, l, -1);
+		}
+		if (count[l] < h->min[l]) {
+			need += h->min[l] - count[l];
+		}
+	}
+	/* letters still to be typed can make up for what's missing so far */
+	if (need > h->len - i) {
+		for (l = 0; l < 26; ++l) {
+			if (count[l] < h->min[l]) {
+				HARD_FAULT(HARD_MISSING, l, -1);
+			}
+		}
+	}
+#undef HARD_FAULT
+	return faults;
+}
+
+/* whether w, a whole word, keeps to every rule */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool hard_allows(const struct hard *h, word_t w)
+{
+	uint8_t count[26] = {0};
+	int i, l;
+
+	for (i = 0; i < h->len; ++i) {
+		l = word_letter(w, i);
+		if (!(h->allowed[i] >> l & 1))
+			return false;
+		count[l] += h->counted >> l & 1;
+	}
+	for (i = 0; i < h->bounds; ++i) {
+		l = h->bounded[i];
+		if (count[l] < h->min[l] || count[l] > h->max[l])
+			return false;
+	}
+	return true;
+}
+
+/* Move those of the n words that keep to every rule to the front of words,
+ * in order, returning how many there are. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static size_t hard_filter(const struct hard *h, word_t *words, size_t n)
+{
+	size_t i, kept = 0;
+
+	for (i = 0; i < n; ++i) {
+		if (hard_allows(h, words[i])) {
+			words[kept++] = words[i];
+		}
+	}
+	return kept;
+}
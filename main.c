@@ -1,8 +1,10 @@
 #define _GNU_SOURCE
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <locale.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,14 +17,21 @@
 #include "xmem.h"
 #include "sopt.h"
 #include "cursutil.h"
+#include "dict.h"
+#include "score.h"
+#include "matrix.h"
+#include "solver.h"
+#include "trace.h"
+#include "stats.h"
+#include "stream.h"
+#include "dawg.h"
+#include "hard.h"
+#include "game.h"
+#include "serve.h"
 
 #define RND_IMPLEMENTATION
 #include "rnd.h"
 
-#ifdef ANCIENT
-#include "getline.h"
-#endif
-
 
 enum cell_type {
 	CELL_CHAR = 1,
@@ -34,12 +43,19 @@ enum cell_type {
 
 
 int cell_attr[CELL__COUNT] = {0};
+/* how each digit of a pattern is shown */
+const enum cell_type digit_cell[] = {
+	[PATTERN_WRONG] = CELL_WRONG,
+	[PATTERN_MISPLACED] = CELL_CHAR,
+	[PATTERN_RIGHT] = CELL_RIGHT,
+};
 int color_count = -1;
 
 bool hard_mode = false;
+/* letters per word and rows per game, fixed at startup */
+int word_len = WORD_LEN_DEFAULT;
+int row_count = ROW_DEFAULT;
 
-#define ROW_COUNT 6
-#define WORD_LEN 5
 #define CHARSET "abcdefghijklmnopqrstuvwxyz"
 #define QWERTY  "qwertyuiopasdfghjklzxcvbnm"
 #define CHARSET_LEN (sizeof(CHARSET) - 1)
@@ -47,17 +63,76 @@ bool hard_mode = false;
 static_assert(sizeof(CHARSET) == sizeof(QWERTY), "Character set does not match keyboard layout");
 
 
-#define GAMESTAT_MISS ROW_COUNT /* miss location in gamestat*/
-#define GAMESTAT_SUM (ROW_COUNT + 1) /* Total games played */
-#define GAMESTAT_LEN (GAMESTAT_SUM + 1) /* store miss, and a checksum at the end*/
-size_t game_stat[GAMESTAT_LEN];
-
-int char_stat[CHARSET_LEN];
-char **wordlist;
-size_t wordcount;
+size_t game_stat[GAMESTAT_MAX];
+/* results not yet written out, because the file was locked or missing */
+size_t game_stat_pending[GAMESTAT_MAX];
+
+/* the game being played */
+struct game game;
+/* scratch memory for ranking hints, emptied before each one, the blocks
+ * kept for the next */
+struct xarena hint_arena;
+/* with --connect, the server that knows the answers */
+FILE *remote = NULL;
+/* the dictionary file's words of every length, and those of word_len */
+struct lexicon lexicon;
+struct dict wordlist;
+/* With --answers, wordlist is the answers and these are the other words
+ * that may be guessed, checked against the filter before the dict. */
+struct lexicon answer_lexicon;
+bool split_answers = false;
+struct dict guesses;
+struct bloom guess_bloom;
+/* the lists above as word graphs, for checking guesses in less memory */
+struct dawg wordlist_dawg;
+struct dawg guesses_dawg;
+/* with --stream, the words are only known through this */
+bool streaming = false;
+struct stream_sample stream;
+/* the scoring kernels for word_len */
+struct scorer score;
+/* answers still possible in the current game */
+struct candidates cand;
+struct letter_masks masks;
+/* The best openers, and the hint table where it's small enough to be worth
+ * keeping, are worked out on a thread of their own from the first hint, so
+ * no key waits on them; until they're done, and for bigger tables always,
+ * hints are scored as they're asked for. */
+#define HINT_TABLE_MAX ((size_t)64 << 20)
+struct hint_prep {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	bool started, done;
+	/* with --answers, the words that may be guessed besides */
+	word_t *extra;
+	size_t extras;
+	struct pattern_matrix matrix;
+	struct hint opening[HINT_COUNT];
+} hint_prep = { .lock = PTHREAD_MUTEX_INITIALIZER };
+char *cachedir = NULL;
 
 WINDOW *qwerty_win, *row_win, *stat_win;
 
+/* A cell of the board. Type 0 is a cell of a row not reached yet, which is
+ * left empty. */
+struct cell {
+	int type;
+	char c;
+};
+
+/* the board as the game wants it shown */
+struct cell board[ROW_MAX][WORD_LEN_MAX];
+
+/* What was last put on screen. Drawing compares the game state against this
+ * and only issues curses calls for what differs; render() then pushes it all
+ * out at once. Clearing valid forces everything to be redrawn. */
+struct screen {
+	bool valid;
+	struct cell board[ROW_MAX][WORD_LEN_MAX];
+	int keys[CHARSET_LEN];
+	char stat[GAMESTAT_MAX][32];
+} screen;
+
 #define PRINT_HELP_BOLD_DESC(bold, desc) do { \
 	cu_stat_aprintw(A_BOLD, "%s", bold); \
 	cu_stat_aprintw(A_NORMAL, ": %s; ", desc); \
@@ -75,227 +150,467 @@ void print_help(void)
 	PRINT_HELP_CELL(CELL_RIGHT, "right");
 	PRINT_HELP_BOLD_DESC("^C", "quit");
 	PRINT_HELP_BOLD_DESC("^D", "new");
+	PRINT_HELP_BOLD_DESC("^G", "hint");
 	refresh();
 }
 
 
-/* calculate the sum, based on rows and miss. DO NOT STORE */
-size_t sum_game_stat(const size_t gs[static GAMESTAT_LEN])
+/* pick up games other instances have recorded, and write out ours */
+void sync_game_stat(void)
 {
-	size_t sum = 0, i;
-	for (i = 0; i < GAMESTAT_SUM; ++i) {
-		sum += gs[i];
-	}
-	return sum;
-}
-
-int valid_game_stat(const size_t gs[static GAMESTAT_LEN])
-{
-	return gs[GAMESTAT_SUM] == sum_game_stat(gs);
-}
+	int i, fd;
+	bool dirty = false;
+	enum trace_phase phase = trace_enter(TRACE_STATS);
 
-int open_game_stat(char *path)
-{
-	int fd;
-	if (!path) {
-		if (!getenv("HOME")) {
-			return -1;
+	if ((fd = open_game_stat(game_stat_path(word_len, row_count))) == -1) {
+		trace_enter(phase);
+		return;
+	}
+	/* the file replaces what we had, so add our new results back in */
+	if (load_game_stat(fd, game_stat, row_count)) {
+		for (i = 0; i < GAMESTAT_SUM(row_count); ++i) {
+			game_stat[i] += game_stat_pending[i];
 		}
-		xasprintf(&path, "%s/.local/share/cordl_stat", getenv("HOME"));
 	}
-	if ((fd = open(path, O_RDWR | O_CREAT, 0755)) == -1) {
-		free(path);
-		return -1;
+	for (i = 0; i < GAMESTAT_SUM(row_count); ++i) {
+		dirty |= game_stat_pending[i] != 0;
+		game_stat_pending[i] = 0;
 	}
-	if (lockf(fd, F_LOCK, sizeof(game_stat)) == -1) {
-		close(fd);
-		free(path);
-		return -1;
+	game_stat[GAMESTAT_SUM(row_count)] = sum_game_stat(game_stat, row_count);
+
+	if (dirty) {
+		store_game_stat(fd, game_stat, row_count);
 	}
-	free(path);
-	return fd;
+	close_game_stat(fd);
+	trace_enter(phase);
 }
 
-void close_game_stat(int fd)
+/* draw the stats as we have them, without touching the file */
+void draw_game_stat(void)
 {
-	if (fd == -1) {
-		return;
+	char line[GAMESTAT_MAX][sizeof(screen.stat[0])];
+	bool dirty = false;
+	int i;
+
+	for (i = 0; i < row_count; ++i) {
+		snprintf(line[i], sizeof(line[i]), "  %d  | %zu", i + 1, game_stat[i]);
+	}
+	snprintf(line[GAMESTAT_MISS(row_count)], sizeof(line[0]), "Miss | %zu", game_stat[GAMESTAT_MISS(row_count)]);
+	if (streaming || remote) {
+		snprintf(line[GAMESTAT_SUM(row_count)], sizeof(line[0]), "Left | ?");
+	} else {
+		snprintf(line[GAMESTAT_SUM(row_count)], sizeof(line[0]), "Left | %zu", cand.count);
 	}
 
-	lockf(fd, F_ULOCK, sizeof(game_stat));
-	close(fd);
+	for (i = 0; i < GAMESTAT_LEN(row_count); ++i) {
+		if (screen.valid && !strcmp(line[i], screen.stat[i]))
+			continue;
+		mvwaddstr(stat_win, i, 1, line[i]);
+		wclrtoeol(stat_win);
+		strcpy(screen.stat[i], line[i]);
+		dirty = true;
+	}
+	if (dirty) {
+		wnoutrefresh(stat_win);
+	}
 }
 
-void load_game_stat(int fd)
+/* record a result, if won >= 0, then sync with the file and redraw */
+void game_status(int won)
 {
-	size_t gs_in[GAMESTAT_LEN];
-
-	if (fd == -1) {
-		return;
+	if (won >= 0) {
+		++game_stat[won];
+		++game_stat_pending[won];
+		game_stat[GAMESTAT_SUM(row_count)] = sum_game_stat(game_stat, row_count);
 	}
+	sync_game_stat();
+	draw_game_stat();
+}
 
-	lseek(fd, 0, SEEK_SET);
-	if (read(fd, gs_in, sizeof(gs_in)) == sizeof(gs_in)) {
-		if (valid_game_stat(gs_in)) {
-			memcpy(game_stat, gs_in, sizeof(game_stat));
+
+void qwerty_status(void)
+{
+	int i, l, ch, type;
+	bool dirty = false;
+
+	for (i = 0; i < CHARSET_LEN; ++i) {
+		l = QWERTY[i] - 'a';
+		type = game.letter[l] ? digit_cell[game.letter[l] - 1] : CELL_BLANK;
+		if (screen.valid && screen.keys[l] == type)
+			continue;
+		ch = cell_attr[type] | CHARSET[l];
+		if (i < 10) { /* first row */
+			mvwaddch(qwerty_win, 1, (i * 2) + 1, ch);
+		} else if (i < 19) {
+			mvwaddch(qwerty_win, 3, ((i - 10) * 2) + 3, ch);
+		} else {
+			mvwaddch(qwerty_win, 5, ((i - 19) * 2) + 5, ch);
 		}
+		screen.keys[l] = type;
+		dirty = true;
+	}
+	if (dirty) {
+		wnoutrefresh(qwerty_win);
 	}
 }
 
-void store_game_stat(int fd)
+/* w is in d, going by its graph g unless that couldn't be built */
+bool list_contains(const struct dict *d, const struct dawg *g, word_t w)
 {
-	if (fd == -1) {
-		return;
-	}
-
-	lseek(fd, 0, SEEK_SET);
-	write(fd, game_stat, sizeof(game_stat));
+	return g->cells ? dawg_contains(g, w) : dict_contains(d, w);
 }
 
-void game_status(int won)
+bool valid_word(char *s)
 {
-	int i, fd;
+	word_t w = word_pack(s);
 
-	fd = open_game_stat(NULL);
-	load_game_stat(fd);
+	if (streaming) {
+		return word_set_contains(&stream.set, w);
+	}
+	if (list_contains(&wordlist, &wordlist_dawg, w)) {
+		return true;
+	}
+	return split_answers && bloom_maybe(&guess_bloom, w) && list_contains(&guesses, &guesses_dawg, w);
+}
 
-	if (won >= 0) {
-		++game_stat[won];
+/* a word to play against */
+word_t pick_word(rnd_pcg_t *pcg)
+{
+	if (streaming) {
+		return stream.target[rnd_pcg_range(pcg, 0, stream.targets - 1)];
 	}
-	game_stat[GAMESTAT_SUM] = sum_game_stat(game_stat);
+	return wordlist.words[rnd_pcg_range(pcg, 0, wordlist.count - 1)];
+}
 
-	store_game_stat(fd);
-	close_game_stat(fd);
+void *hint_prepare(void *arg)
+{
+	struct pattern_matrix m;
+	struct hint opening[HINT_COUNT];
+	struct xarena scratch = {0};
+	uint32_t *all;
+	size_t i;
 
-	for (i = 0; i < ROW_COUNT; ++i) {
-		mvwprintw(stat_win, i, 1, "  %d  | %zu", i + 1, game_stat[i]);
+	(void)arg;
+	memset(&m, 0, sizeof(m));
+	if (wordlist.count * wordlist.count * score.pattern_size <= HINT_TABLE_MAX) {
+		/* on failure we just score as we go */
+		matrix_open(&m, &wordlist, cachedir, 0);
 	}
-	mvwprintw(stat_win, GAMESTAT_MISS, 1, "Miss | %zu", game_stat[GAMESTAT_MISS]);
-	wnoutrefresh(stat_win);
+	all = xarena_calloc(&scratch, wordlist.count, sizeof(*all));
+	for (i = 0; i < wordlist.count; ++i) {
+		all[i] = i;
+	}
+	hint_rank(&wordlist, hint_prep.extra, hint_prep.extras, &m, all, wordlist.count, NULL, opening, HINT_COUNT, 0, &scratch);
+	xarena_free(&scratch);
+
+	pthread_mutex_lock(&hint_prep.lock);
+	hint_prep.matrix = m;
+	memcpy(hint_prep.opening, opening, sizeof(opening));
+	hint_prep.done = true;
+	pthread_mutex_unlock(&hint_prep.lock);
+	return NULL;
 }
 
-
-void qwerty_status(void)
+/* rank guesses against the remaining candidates and show the best few */
+void show_hint(void)
 {
-	int i, ch;
-	/* first row */
-	for (i = 0; i < 10; ++i) {
-		ch = cell_attr[char_stat[QWERTY[i] - 'a']] | CHARSET[QWERTY[i] - 'a'];
-		mvwaddch(qwerty_win, 1, (i * 2) + 1, ch);
+	static const struct pattern_matrix unbuilt;
+	const struct pattern_matrix *m = &unbuilt;
+	struct hint best[HINT_COUNT];
+	char buf[WORD_LEN_MAX + 1];
+	bool done;
+	size_t j;
+	int i, n;
+
+	if (streaming || remote) {
+		cu_stat_setw("No hints without the whole wordlist");
+		return;
 	}
-	for (i = 10; i < 19; ++i) {
-		ch = cell_attr[char_stat[QWERTY[i] - 'a']] | CHARSET[QWERTY[i] - 'a'];
-		mvwaddch(qwerty_win, 3, ((i - 10) * 2) + 3, ch);
+	if (!hint_prep.started) {
+		hint_prep.started = true;
+		if (split_answers) {
+			hint_prep.extra = xcalloc(guesses.count, sizeof(*hint_prep.extra));
+			for (j = 0; j < guesses.count; ++j) {
+				if (!list_contains(&wordlist, &wordlist_dawg, guesses.words[j])) {
+					hint_prep.extra[hint_prep.extras++] = guesses.words[j];
+				}
+			}
+		}
+		if (pthread_create(&hint_prep.thread, NULL, hint_prepare, NULL) == 0) {
+			pthread_detach(hint_prep.thread);
+		} else {
+			hint_prepare(NULL);
+		}
 	}
-	for (i = 19; i < CHARSET_LEN; ++i) {
-		ch = cell_attr[char_stat[QWERTY[i] - 'a']] | CHARSET[QWERTY[i] - 'a'];
-		mvwaddch(qwerty_win, 5, ((i - 19) * 2) + 5, ch);
+	pthread_mutex_lock(&hint_prep.lock);
+	done = hint_prep.done;
+	pthread_mutex_unlock(&hint_prep.lock);
+	if (done) {
+		m = &hint_prep.matrix;
+	}
+	/* the first row always starts from the whole dictionary */
+	if (cand.count == wordlist.count) {
+		if (!done) {
+			cu_stat_setw("Still working out the best openers");
+			return;
+		}
+		/* a row can leave every word possible and still rule some out */
+		memset(best, 0, sizeof(best));
+		for (i = n = 0; i < HINT_COUNT; ++i) {
+			if (!hard_mode || hard_allows(&game.rules, hint_prep.opening[i].word)) {
+				best[n++] = hint_prep.opening[i];
+			}
+		}
+	} else {
+		xarena_reset(&hint_arena);
+		hint_rank(&wordlist, hint_prep.extra, hint_prep.extras, m, candidates_list(&cand), cand.count,
+				hard_mode ? &game.rules : NULL, best, HINT_COUNT, 0, &hint_arena);
 	}
-	wnoutrefresh(qwerty_win);
-}
 
-bool valid_word(char *s)
-{
-	size_t i;
-	for (i = 0; i < wordcount; ++i) {
-		if (!strcmp(s, wordlist[i]))
-			return true;
+	cu_stat_setw("%zu left; try", cand.count);
+	for (i = 0; i < HINT_COUNT && best[i].word; ++i) {
+		cu_stat_aprintw(A_BOLD, " %s", word_unpack(best[i].word, buf));
+		cu_stat_aprintw(A_NORMAL, " (%.2f)", best[i].bits);
 	}
-	return false;
 }
 
 void draw_cell(enum cell_type type, char c, int x, int y)
 {
-	int i, j;
+	int j;
 	wattrset(row_win, cell_attr[type] & ~A_UNDERLINE);
 	x *= 4;
 	y *= 4;
-	for (i = 0; i < 3; ++i) {
-		for (j = 0; j < 3; ++j) {
-			if (i == 1 && j == 1) {
-				mvwaddch(row_win, y + j, x + i, c | cell_attr[type]);
+	for (j = 0; j < 3; ++j) {
+		mvwaddstr(row_win, y + j, x, "   ");
+	}
+	mvwaddch(row_win, y + 1, x + 1, c | cell_attr[type]);
+}
+
+/* redraw the cells that differ from the screen; true if any did */
+bool draw_board(void)
+{
+	struct cell *want, *have;
+	bool dirty = false;
+	int row, i;
+
+	for (row = 0; row < row_count; ++row) {
+		for (i = 0; i < word_len; ++i) {
+			want = &board[row][i];
+			have = &screen.board[row][i];
+			if (screen.valid && want->type == have->type) {
+				if (want->c == have->c)
+					continue;
+				/* just typed or erased, only the letter changes */
+				wattrset(row_win, cell_attr[want->type] & ~A_UNDERLINE);
+				mvwaddch(row_win, (row * 4) + 1, (i * 4) + 1, want->c | cell_attr[want->type]);
 			} else {
-				mvwaddch(row_win, y + j, x + i, ' ');
+				draw_cell(want->type, want->c, i, row);
 			}
+			*have = *want;
+			dirty = true;
 		}
 	}
+	return dirty;
+}
+
+/* bring the screen up to date with the game and send it to the terminal in
+ * one go */
+void render(void)
+{
+	trace_enter(TRACE_DRAW);
+	if (!screen.valid) {
+		werase(row_win);
+		werase(qwerty_win);
+		werase(stat_win);
+	}
+	if (draw_board()) {
+		wnoutrefresh(row_win);
+	}
+	qwerty_status();
+	draw_game_stat();
+	screen.valid = true;
+	trace_enter(TRACE_REFRESH);
+	doupdate();
+	trace_paint();
 }
 
 void clear_row(int row)
 {
 	int i;
-	for (i = 0; i < 3; ++i) {
-		wmove(row_win, (row * 4) + i, 0);
-		wclrtoeol(row_win);
+	for (i = 0; i < word_len; ++i) {
+		board[row][i].type = 0;
+		board[row][i].c = ' ';
 	}
 }
 
-void draw_row(int row, char *word, char *txt)
+/* a row played, one cell per letter as scored, or blank if it's yet to be */
+void draw_row(int row)
 {
+	pattern_t p = game.pat[row];
 	int i;
-	enum cell_type type;
-	int word_letters[26] = {0};
 
-	if (word) {
-		for (i = 0; i < WORD_LEN; ++i) {
-			if (word[i] != txt[i]) {
-				++word_letters[word[i] - 'a'];
-			}
+	for (i = 0; i < word_len; ++i) {
+		if (row >= game.row) {
+			board[row][i].type = CELL_BLANK;
+			board[row][i].c = ' ';
+		} else {
+			board[row][i].type = digit_cell[p % 3];
+			board[row][i].c = game.text[row][i];
+			p /= 3;
 		}
 	}
+}
 
-	clear_row(row);
-	for (i = 0; i < WORD_LEN; ++i) {
-		if (!word) {
-			draw_cell(CELL_BLANK, ' ', i, row);
-		} else {
-			if (txt[i] == word[i]) {
-				type = CELL_RIGHT;
-			} else if (word_letters[txt[i] - 'a']) {
-				type = CELL_CHAR;
-				--word_letters[txt[i] - 'a'];
-			} else {
-				type = CELL_WRONG;
-			}
-			char_stat[txt[i] - 'a'] = type;
-			draw_cell(type, txt[i], i, row);
+/* Show every hard mode rule the first n letters of s break, or clear what
+ * was shown for them before once there are none. Returns whether s keeps to
+ * the rules so far. */
+bool hard_status(const char *s, int n)
+{
+	static bool shown = false;
+	struct hard_fault fault[HARD_FAULTS_MAX];
+	int i, faults = hard_check(&game.rules, s, n, fault, HARD_FAULTS_MAX);
+	int l;
+
+	if (!faults) {
+		if (shown) {
+			cu_stat_setw("");
+		}
+		shown = false;
+		return true;
+	}
+	cu_stat_setw("");
+	for (i = 0; i < faults; ++i) {
+		l = fault[i].letter;
+		cu_stat_aprintw(A_NORMAL, "%s", i ? "; " : "");
+		switch (fault[i].rule) {
+			case HARD_MOVED:
+				cu_stat_aprintw(A_NORMAL, "%c must be used in correct position", CHARSET[l]);
+				break;
+			case HARD_TRIED:
+				cu_stat_aprintw(A_NORMAL, "%c already tried in wrong position", CHARSET[l]);
+				break;
+			case HARD_EXTRA:
+				if (game.rules.max[l]) {
+					cu_stat_aprintw(A_NORMAL, "%c used more than %d times", CHARSET[l], game.rules.max[l]);
+				} else {
+					cu_stat_aprintw(A_NORMAL, "%c already tried", CHARSET[l]);
+				}
+				break;
+			case HARD_MISSING:
+				cu_stat_aprintw(A_NORMAL, "%c must be used in solution", CHARSET[l]);
+				break;
 		}
 	}
-	wnoutrefresh(row_win);
+	shown = true;
+	return false;
 }
 
-bool input_row(int row, char **rows, char *word)
+/* the next line from the server, without the newline; there's no playing
+ * on without it, so losing it is fatal */
+char *remote_line(void)
 {
+	static char *line = NULL;
+	static size_t n = 0;
+	ssize_t len;
+
+	if ((len = getline(&line, &n, remote)) <= 0) {
+		endwin();
+		fprintf(stderr, "Lost the server\n");
+		exit(1);
+	}
+	if (line[len - 1] == '\n') {
+		line[len - 1] = '\0';
+	}
+	return line;
+}
+
+/* send a request to the server and return its reply */
+char *remote_ask(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vdprintf(fileno(remote), fmt, ap);
+	va_end(ap);
+	dprintf(fileno(remote), "\n");
+	return remote_line();
+}
+
+/* stop on a reply that makes no sense */
+void remote_fail(const char *reply)
+{
+	endwin();
+	fprintf(stderr, "Unexpected reply from the server: %s\n", reply);
+	exit(1);
+}
+
+/* Score s against the answer, into p, if s may be guessed at all. With
+ * --connect, the server does both, and tells the answer once the game is
+ * over. */
+bool guess_word(const char *s, pattern_t *p)
+{
+	char *reply, *digits;
 	int i;
-	int j;
+
+	if (!remote) {
+		if (!valid_word((char *)s)) {
+			return false;
+		}
+		*p = score.word(game.word, word_pack(s));
+		return true;
+	}
+	reply = remote_ask("guess %s", s);
+	if (!strcmp(reply, "invalid")) {
+		return false;
+	}
+	if (strncmp(reply, "pattern ", 8) || strlen(reply) < 8 + (size_t)word_len) {
+		remote_fail(reply);
+	}
+	digits = reply + 8;
+	*p = 0;
+	for (i = word_len - 1; i >= 0; --i) {
+		if (digits[i] < '0' || digits[i] > '2') {
+			remote_fail(reply);
+		}
+		*p = *p * 3 + digits[i] - '0';
+	}
+	if (digits[word_len] == ' ') {
+		game.word = word_pack(digits + word_len + 1);
+	}
+	return true;
+}
+
+/* Take the next row, storing the pattern it got in p. Returns false if the
+ * game was given up. */
+bool input_row(pattern_t *p)
+{
+	int row = game.row;
+	char *text = game.text[row];
 	int c;
 	int pos;
-	draw_row(row, NULL, NULL);
+	bool valid;
+	draw_row(row);
 	pos = 0;
-	memset(rows[row], 0, WORD_LEN + 1);
-	wattron(row_win, cell_attr[CELL_BLANK]);
+	memset(text, 0, word_len + 2);
 	while (1) {
-input_row_continue:
-		qwerty_status();
-		game_status(-1);
-		refresh();
-		if (pos < WORD_LEN) {
+		render();
+		if (pos < word_len) {
 			c = mvwgetch(row_win, 1 + (row * 4), 1 + (pos * 4));
 		} else {
 			curs_set(0);
 			c = wgetch(row_win);
 			curs_set(1);
 		}
-		if (pos > WORD_LEN) {
+		trace_key(c);
+		if (pos > word_len) {
 			/* only backspace is allowed */
 			switch (c) {
 				CASE_ALL_BACKSPACE:
 					--pos;
-					rows[row][pos] = '\0';
+					text[pos] = '\0';
 					break;
 				default:
 					cu_stat_setw("Word too long");
-					wnoutrefresh(row_win);
 					continue;
 			}
 		}
@@ -304,131 +619,276 @@ input_row_continue:
 				if (pos) {
 					--pos;
 				}
-				rows[row][pos] = '\0';
-				mvwaddch(row_win, 1 + (row * 4), 1 + (pos * 4), ' ');
-				wnoutrefresh(row_win);
+				text[pos] = '\0';
+				if (pos < word_len) {
+					board[row][pos].c = ' ';
+				}
+				if (hard_mode) {
+					trace_enter(TRACE_VALIDATE);
+					hard_status(text, pos);
+					trace_enter(TRACE_INPUT);
+				}
 				continue;
 			CASE_ALL_RETURN:
-				if (pos < WORD_LEN) {
+				if (pos < word_len) {
 					cu_stat_setw("Word too short");
-					wnoutrefresh(row_win);
 					continue;
 				}
-				if (hard_mode) {
-					for (i = 0; i < CHARSET_LEN; ++i) {
-						if ((char_stat[i] == CELL_CHAR) || (char_stat[i] == CELL_RIGHT)) {
-							if (!strchr(rows[row], CHARSET[i])) {
-								cu_stat_setw("%c must be used in solution", CHARSET[i]);
-								wnoutrefresh(row_win);
-								goto input_row_continue;
-							}
-						}
-					}
-					for (i = 0; i < row; ++i) {
-						for (j = 0; j < WORD_LEN; ++j) {
-							if (rows[i][j] == rows[row][j]) {
-								if (rows[row][j] != word[j]) {
-									cu_stat_setw("%c already tried in wrong position", rows[row][j]);
-									wnoutrefresh(row_win);
-									goto input_row_continue;
-								}
-							} else if (rows[i][j] == word[j]) {
-								cu_stat_setw("%c must be used in correct position", rows[i][j]);
-								wnoutrefresh(row_win);
-								goto input_row_continue;
-							}
-							if (char_stat[rows[row][j] - 'a'] == CELL_WRONG) {
-								cu_stat_setw("%c already tried", rows[row][j]);
-								wnoutrefresh(row_win);
-								goto input_row_continue;
-							}
-						}
-					}
+				trace_enter(TRACE_VALIDATE);
+				if (hard_mode && !hard_status(text, pos)) {
+					trace_enter(TRACE_INPUT);
+					continue;
 				}
-
-				if (valid_word(rows[row])) {
+				valid = guess_word(text, p);
+				trace_enter(TRACE_INPUT);
+				if (valid) {
 					return true;
 				}
 				pos = 0;
-				draw_row(row, NULL, NULL);
-				wattron(row_win, cell_attr[CELL_BLANK]);
-				cu_stat_setw("'%s' isn't a word", rows[row]);
-				wnoutrefresh(row_win);
+				draw_row(row);
+				cu_stat_setw("'%s' isn't a word", text);
 				continue;
 			case CTRL_('c'):
 				endwin();
 				exit(0);
 			case CTRL_('d'):
 				return false;
+			case CTRL_('g'):
+				show_hint();
+				continue;
 			default:
 				if (!islower(c)) {
 					beep();
 					print_help();
-					wnoutrefresh(row_win);
 					continue;
 				}
-				rows[row][pos] = c;
-				mvwaddch(row_win, 1 + (row * 4), 1 + (pos++ * 4), c);
-				wnoutrefresh(row_win);
+				text[pos] = c;
+				if (pos < word_len) {
+					board[row][pos].c = c;
+				}
+				++pos;
+				if (hard_mode && pos <= word_len) {
+					trace_enter(TRACE_VALIDATE);
+					hard_status(text, pos);
+					trace_enter(TRACE_INPUT);
+				}
 		}
 	}
 	return true;
 }
 
-bool is_valid_charset_len(char *str, char *charset)
+/* play one game against word without curses, always guessing at random from
+ * the candidates still consistent with every earlier row. cand must start out
+ * holding all count words, and is narrowed in place; pat is scratch space for
+ * as many patterns. Returns the winning row, or GAMESTAT_MISS(row_count). */
+int simulate_game(word_t word, word_t *cand, size_t count, pattern_t *pat, rnd_pcg_t *pcg)
 {
+	pattern_t want;
+	word_t guess;
+	size_t i, n;
+	int row;
+
+	for (row = 0; row < row_count; ++row) {
+		guess = cand[rnd_pcg_bounded64(pcg, count)];
+		if (guess == word) {
+			return row;
+		}
+		want = score.word(word, guess);
+		score.batch(guess, cand, count, pat);
+		for (i = n = 0; i < count; ++i) {
+			if (pat[i] == want) {
+				cand[n++] = cand[i];
+			}
+		}
+		count = n;
+	}
+	return GAMESTAT_MISS(row_count);
+}
+
+/* play games headless, printing the results as game_status() would along
+ * with the throughput. Every game is against word if it is non-zero. */
+/* Games are simulated in parallel, game g drawing from its own stretch of
+ * the generator, SIM_STRIDE values on from the last game's, so the results
+ * for a seed don't depend on how the games are shared out. */
+#define SIM_CHUNK 64
+#define SIM_STRIDE (1ull << 32)
+
+struct sim_job {
+	word_t word;
+	rnd_pcg_t pcg;
+	size_t dist[GAMESTAT_MAX];
+	pthread_mutex_t lock;
+};
+
+void simulate_games(void *arg, size_t begin, size_t end)
+{
+	struct sim_job *job = arg;
+	size_t dist[GAMESTAT_MAX] = {0};
+	rnd_pcg_t pcg = job->pcg, game_pcg;
+	word_t *cand;
+	pattern_t *pat;
+	size_t g;
 	int i;
-	for (i = 0; str[i]; ++i) {
-		if (i == WORD_LEN)
-			return false;
-		if (!strchr(charset, str[i]))
-			return false;
+
+	cand = xcalloc(wordlist.count, sizeof(*cand));
+	pat = xcalloc(wordlist.count, sizeof(*pat));
+	rnd_pcg_advance(&pcg, begin * SIM_STRIDE);
+	for (g = begin; g < end; ++g) {
+		game_pcg = pcg;
+		memcpy(cand, wordlist.words, wordlist.count * sizeof(*cand));
+		++dist[simulate_game(job->word ? job->word : wordlist.words[rnd_pcg_bounded64(&game_pcg, wordlist.count)],
+					cand, wordlist.count, pat, &game_pcg)];
+		rnd_pcg_advance(&pcg, SIM_STRIDE);
 	}
-	if (i != WORD_LEN)
-		return false;
-	return true;
+	free(cand);
+	free(pat);
+
+	pthread_mutex_lock(&job->lock);
+	for (i = 0; i < GAMESTAT_LEN(row_count); ++i) {
+		job->dist[i] += dist[i];
+	}
+	pthread_mutex_unlock(&job->lock);
 }
 
-char **read_all_lines(FILE *f, char *charset)
+void simulate(long games, word_t word, rnd_pcg_t *pcg)
 {
-        size_t len = 24;
-        size_t pos = 0;
-        size_t n;
-        ssize_t line_len;
-        char **line;
-
-        line = xcalloc(sizeof(*line), len);
-        for (pos = 0; ;++pos) {
-                if (pos == len) {
-                        len *= 3;
-                        len /= 2;
-                        line = xreallocarray(line, len, sizeof(*line));
-                        memset(line + pos, 0, sizeof(*line) * (len - pos));
-                }
-                n = 0;
-                if ((line_len = getline(line + pos, &n, f)) == -1)
-                        break;
-                line[pos][line_len - 1] = '\0'; // strip newline
-                //validate charset & length
-                if (!is_valid_charset_len(line[pos], charset)) {
-                        --pos; //we'll be redoing this one.
-                }
-        }
-        line[pos] = NULL;
-        return xreallocarray(line, sizeof(*line), pos + 1);
+	struct sim_job job;
+	struct timespec start, end;
+	double secs;
+	int i;
+
+	memset(&job, 0, sizeof(job));
+	job.word = word;
+	job.pcg = *pcg;
+	pthread_mutex_init(&job.lock, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	par_for(games, SIM_CHUNK, 0, simulate_games, &job);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_mutex_destroy(&job.lock);
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	for (i = 0; i < row_count; ++i) {
+		printf("  %d  | %zu\n", i + 1, job.dist[i]);
+	}
+	printf("Miss | %zu\n", job.dist[GAMESTAT_MISS(row_count)]);
+	printf("%ld games in %.3fs (%.0f games/s)\n", games, secs, secs > 0 ? games / secs : 0);
+}
+
+/* rate every word that may be guessed as the first, printing them best first
+ * as CSV */
+void rank_openers(void)
+{
+	struct opener *op;
+	struct timespec start, end;
+	char buf[WORD_LEN_MAX + 1];
+	size_t i, n = 0;
+	double secs;
+
+	op = xcalloc(wordlist.count + guesses.count, sizeof(*op));
+	for (i = 0; i < wordlist.count; ++i) {
+		op[n].word = wordlist.words[i];
+		op[n++].answer = true;
+	}
+	/* with --answers, the other words that may be guessed */
+	for (i = 0; i < guesses.count; ++i) {
+		if (!list_contains(&wordlist, &wordlist_dawg, guesses.words[i])) {
+			op[n++].word = guesses.words[i];
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	opener_rank(&wordlist, op, n, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("rank,word,expected_left,entropy_bits,worst_left,answer\n");
+	for (i = 0; i < n; ++i) {
+		printf("%zu,%s,%.4f,%.4f,%u,%d\n", i + 1, word_unpack(op[i].word, buf), op[i].left, op[i].bits,
+				op[i].worst, op[i].answer);
+	}
+	fprintf(stderr, "%zu openers against %zu answers in %.3fs\n", n, wordlist.count, secs);
+	free(op);
+}
+
+/* one request from a --serve client, as laid out in serve.h */
+bool serve_request(void *arg, struct serve_session *s, char *line)
+{
+	struct game *g = &s->game;
+	char digits[WORD_LEN_MAX + 1], buf[WORD_LEN_MAX + 1];
+	char *guess = line + 6;
+	word_t w;
+	pattern_t p;
+	int i;
+
+	if (!strcmp(line, "new")) {
+		game_start(g, word_len, row_count, pick_word(arg));
+		serve_reply(s, "ok");
+	} else if (!strncmp(line, "guess ", 6)) {
+		if (!g->word || game_over(g)) {
+			serve_reply(s, "error no game");
+			return true;
+		}
+		for (i = 0; islower((unsigned char)guess[i]); ++i);
+		if (i != word_len || guess[i] || !valid_word(guess)) {
+			serve_reply(s, "invalid");
+			return true;
+		}
+		w = word_pack(guess);
+		p = score.word(g->word, w);
+		game_add(g, w, p);
+		for (i = 0; i < word_len; ++i) {
+			digits[i] = '0' + pattern_digit(p, i);
+		}
+		digits[i] = '\0';
+		if (game_over(g)) {
+			serve_reply(s, "pattern %s %s", digits, word_unpack(g->word, buf));
+		} else {
+			serve_reply(s, "pattern %s", digits);
+		}
+	} else if (!strcmp(line, "giveup")) {
+		if (!g->word || game_over(g)) {
+			serve_reply(s, "error no game");
+			return true;
+		}
+		serve_reply(s, "answer %s", word_unpack(g->word, buf));
+		g->row = g->rows;
+	} else if (!strcmp(line, "quit")) {
+		return false;
+	} else {
+		serve_reply(s, "error unknown request");
+	}
+	return true;
 }
 
 struct sopt optspec[] = {
-	SOPT_INIT_ARGL('w', "wordlist", SOPT_ARGTYPE_STR, "dict", "List of words (one per line) to use as dictionary"),
+	SOPT_INIT_ARGL('w', "wordlist", SOPT_ARGTYPE_STR, "dict", "List of words (one per line) to use as dictionary, - for stdin"),
+	SOPT_INIT_ARGL('a', "answers", SOPT_ARGTYPE_STR, "file", "Draw answers from this list instead, any word of either list being a valid guess"),
+	SOPT_INITL('s', "stream", "Read the wordlist in one pass, keeping only what's needed to play (implied by -w -)"),
 	SOPT_INIT_ARGL('W', "word", SOPT_ARGTYPE_STR, "word", "Set initial word"),
 	SOPT_INITL('m', "monochrome", "Force monochrome mode"),
 	SOPT_INITL('l', "lowcolor", "Force 8 color mode"),
 	SOPT_INITL('H', "highcolor", "Force 16-color mode"),
 	SOPT_INITL('h', "help", "Help message"),
 	SOPT_INITL('x', "hard", "Hard mode"),
+	SOPT_INIT_ARGL('S', "simulate", SOPT_ARGTYPE_LONG, "games", "Play games without curses and report results"),
+	SOPT_INITL('R', "rank-openers", "Rate every allowed first guess against every answer and print them as CSV, best first"),
+	SOPT_INIT_ARGL('L', "length", SOPT_ARGTYPE_INT, "letters", "Letters per word, 4 to 8 (default 5, or that of --word)"),
+	SOPT_INIT_ARGL('r', "rows", SOPT_ARGTYPE_INT, "rows", "Guesses per game, 1 to 9 (default 6)"),
+	SOPT_INIT_ARGL('D', "serve", SOPT_ARGTYPE_STR, "socket", "Play games for --connect clients at this unix socket, holding the words once for all"),
+	SOPT_INIT_ARGL('c', "connect", SOPT_ARGTYPE_STR, "socket", "Play a game served by cordl --serve at this unix socket"),
+	SOPT_INIT_ARGL('t', "trace", SOPT_ARGTYPE_STR, "file", "Write keypress to paint latencies to file, summed up on exit"),
 	SOPT_INIT_END
 };
 
+/* leave curses so the summary isn't drawn over */
+void trace_exit(void)
+{
+	if (!isendwin()) {
+		endwin();
+	}
+	trace_report(stderr);
+}
+
 int main(int argc, char **argv)
 {
 	/* sopt things*/
@@ -436,14 +896,23 @@ int main(int argc, char **argv)
 	union sopt_arg soptarg;
 
 	char *dictpath = "/usr/share/dict/words";
-	FILE *words;
+	char *answerpath = NULL;
 	int i;
-	size_t word;
+	size_t n;
+	word_t word;
+	pattern_t pat;
+	char word_str[WORD_LEN_MAX + 1];
 	char *initial_word = NULL;
-	char **rows;
+	char *serve_path = NULL, *connect_path = NULL;
+	char *reply;
+	int fd;
 	rnd_pcg_t pcg;
 	bool force_mono = false;
-	bool won;
+	long sim_games = 0;
+	bool openers = false;
+	char *trace_path = NULL;
+	bool len_set = false;
+	FILE *dict_file;
 
 	if (!(dictpath = getenv("CORDL_WORDS"))) {
 		dictpath = "/usr/share/dict/words";
@@ -471,29 +940,174 @@ int main(int argc, char **argv)
 			case 'x':
 				hard_mode = true;
 				break;
+			case 's':
+				streaming = true;
+				break;
+			case 'a':
+				answerpath = soptarg.str;
+				break;
 			case 'W':
 				initial_word = xstrdup(soptarg.str);
 				break;
+			case 'S':
+				if (soptarg.l <= 0) {
+					fprintf(stderr, "Number of games must be positive\n");
+					return 1;
+				}
+				sim_games = soptarg.l;
+				break;
+			case 'R':
+				openers = true;
+				break;
+			case 'D':
+				serve_path = soptarg.str;
+				break;
+			case 'c':
+				connect_path = soptarg.str;
+				break;
+			case 't':
+				trace_path = soptarg.str;
+				break;
+			case 'L':
+				if (soptarg.i < WORD_LEN_MIN || soptarg.i > WORD_LEN_MAX) {
+					fprintf(stderr, "Word length must be %d to %d\n", WORD_LEN_MIN, WORD_LEN_MAX);
+					return 1;
+				}
+				word_len = soptarg.i;
+				len_set = true;
+				break;
+			case 'r':
+				if (soptarg.i < ROW_MIN || soptarg.i > ROW_MAX) {
+					fprintf(stderr, "Row count must be %d to %d\n", ROW_MIN, ROW_MAX);
+					return 1;
+				}
+				row_count = soptarg.i;
+				break;
 			default:
 				sopt_usage_s();
 				return 1;
 		}
 	}
 
-	rows = xcalloc(ROW_COUNT, sizeof(*rows));
-	for (i = 0; i < ROW_COUNT; ++i) {
-		rows[i] = xcalloc(1, WORD_LEN + 1);
+	if (initial_word && !len_set) {
+		word_len = strlen(initial_word);
+		if (word_len < WORD_LEN_MIN || word_len > WORD_LEN_MAX) {
+			fprintf(stderr, "%s is not %d to %d letters\n", initial_word, WORD_LEN_MIN, WORD_LEN_MAX);
+			return 1;
+		}
 	}
+	if (connect_path) {
+		if (serve_path || sim_games || openers || initial_word) {
+			fprintf(stderr, "--connect plays the server's words, with none of its own\n");
+			return 1;
+		}
+		if ((fd = serve_connect(connect_path)) == -1 || !(remote = fdopen(fd, "r"))) {
+			perror("connect");
+			return 1;
+		}
+		/* a server going away shows up as the end of its replies */
+		signal(SIGPIPE, SIG_IGN);
+		/* the server decides how long the words are, and the rows */
+		reply = remote_line();
+		if (sscanf(reply, "cordl %d %d", &word_len, &row_count) != 2 || word_len < WORD_LEN_MIN
+				|| word_len > WORD_LEN_MAX || row_count < ROW_MIN || row_count > ROW_MAX) {
+			fprintf(stderr, "%s is not a cordl server\n", connect_path);
+			return 1;
+		}
+	}
+	scorer_init(&score, word_len);
 
-	if (!(words = fopen(dictpath, "r"))) {
-		perror("fopen wordlist");
+	rnd_pcg_seed(&pcg, time(NULL) + getpid());
+
+	if (getenv("HOME")) {
+		xasprintf(&cachedir, "%s/.local/share", getenv("HOME"));
+	}
+	if (!strcmp(dictpath, "-")) {
+		streaming = true;
+	}
+	if (remote) {
+		/* the words are all the server's */
+	} else if (streaming) {
+		/* a server's games would all come out of the one small sample */
+		if (sim_games || openers || answerpath || serve_path) {
+			fprintf(stderr, "%s needs the whole wordlist, not --stream\n",
+					sim_games ? "Simulating" : openers ? "Ranking openers" : answerpath ? "--answers" : "--serve");
+			return 1;
+		}
+		if (!(dict_file = strcmp(dictpath, "-") ? fopen(dictpath, "r") : stdin)) {
+			perror("open wordlist");
+			return 1;
+		}
+		if (stream_sample(&stream, dict_file, word_len, &pcg) == -1) {
+			perror("read wordlist");
+			return 1;
+		}
+		if (dict_file != stdin) {
+			fclose(dict_file);
+		} else if (!freopen("/dev/tty", "r", stdin)) {
+			/* curses reads keys from stdin, which held the words */
+			perror("open /dev/tty");
+			return 1;
+		}
+		if (!stream.targets) {
+			fprintf(stderr, "No usable %d letter words in %s\n", word_len, dictpath);
+			return 1;
+		}
+	} else {
+		if (lexicon_open(&lexicon, dictpath, cachedir, 0) == -1) {
+			perror("open wordlist");
+			return 1;
+		}
+		wordlist = lexicon.by_len[word_len];
+		if (answerpath) {
+			if (lexicon_open(&answer_lexicon, answerpath, cachedir, 0) == -1) {
+				perror("open answers");
+				return 1;
+			}
+			split_answers = true;
+			guesses = wordlist;
+			wordlist = answer_lexicon.by_len[word_len];
+			bloom_init(&guess_bloom, guesses.count);
+			for (n = 0; n < guesses.count; ++n) {
+				bloom_add(&guess_bloom, guesses.words[n]);
+			}
+			/* on failure we fall back on the hash index */
+			dawg_open(&guesses_dawg, &guesses, cachedir);
+		}
+		if (!wordlist.count) {
+			fprintf(stderr, "No usable %d letter words in %s\n", word_len, answerpath ? answerpath : dictpath);
+			return 1;
+		}
+		masks_build(&masks, &wordlist);
+		dawg_open(&wordlist_dawg, &wordlist, cachedir);
+	}
+
+	if (serve_path) {
+		serve_run(serve_path, word_len, row_count, serve_request, &pcg);
+		perror("serve");
 		return 1;
 	}
-	wordlist = read_all_lines(words, CHARSET);
-	fclose(words);
-	for (wordcount = 0; wordlist[wordcount]; ++wordcount);
+	if (openers) {
+		rank_openers();
+		return 0;
+	}
+	if (sim_games) {
+		word = 0;
+		if (initial_word && !dict_contains(&wordlist, (word = word_pack(initial_word)))) {
+			fprintf(stderr, "%s is not in the dictionary\n", initial_word);
+			return 1;
+		}
+		simulate(sim_games, word, &pcg);
+		return 0;
+	}
 
-	rnd_pcg_seed(&pcg, time(NULL) + getpid());
+	if (trace_path) {
+		if (trace_open(trace_path) == -1) {
+			perror("open trace");
+			return 1;
+		}
+		atexit(trace_exit);
+	}
 
 	setlocale(LC_ALL, "");
 
@@ -503,9 +1117,10 @@ int main(int argc, char **argv)
 	noecho();
 	keypad(stdscr, true);
 
-	qwerty_win = newwin(7, 21, 8, 23);
-	row_win = newwin((ROW_COUNT * 4) - 1, WORD_LEN * 4, 0, 0);
-	stat_win = newwin(GAMESTAT_LEN + 1, 21, 0, 23);
+	/* the stats and keyboard sit to the right of the board, keyboard below */
+	qwerty_win = newwin(7, 21, GAMESTAT_LEN(row_count), (word_len * 4) + 3);
+	row_win = newwin((row_count * 4) - 1, word_len * 4, 0, 0);
+	stat_win = newwin(GAMESTAT_LEN(row_count) + 1, 21, 0, (word_len * 4) + 3);
 
 	if (has_colors() && !force_mono) {
 		start_color();
@@ -536,50 +1151,62 @@ int main(int argc, char **argv)
 	}
 
 	print_help();
+	game_status(-1);
 	wrefresh(stat_win);
 
 	do {
-		for (i = 0; i < CHARSET_LEN; ++i) {
-			char_stat[i] = CELL_BLANK;
-		}
-		if (initial_word) {
-			for (word = 0; word < wordcount; ++word) {
-				if (!strcmp(wordlist[word], initial_word))
-					break;
+		if (remote) {
+			if (strcmp((reply = remote_ask("new")), "ok")) {
+				remote_fail(reply);
 			}
-			if (word == wordcount) {
+			word = 0;
+		} else if (initial_word) {
+			word = word_pack(initial_word);
+			if (!valid_word(initial_word)) {
 				break;
 			}
 		} else {
-			word = rnd_pcg_range(&pcg, 0, wordcount - 1);
+			word = pick_word(&pcg);
 		}
+		game_start(&game, word_len, row_count, word);
 
-		qwerty_status();
+		if (!streaming && !remote) {
+			candidates_reset(&cand, &wordlist);
+		}
+		for (i = 0; i < row_count; ++i) {
+			clear_row(i);
+		}
 
-		won = false;
-		for (i = 0; i < ROW_COUNT; ++i) {
-			if (!input_row(i, rows, wordlist[word]))
-				break;
-			draw_row(i, wordlist[word], rows[i]);
-			qwerty_status();
-			refresh();
-			if (!strcmp(rows[i], wordlist[word])) {
-				won = true;
+		while (!game_over(&game)) {
+			if (!input_row(&pat))
 				break;
+			word = word_pack(game.text[game.row]);
+			game_add(&game, word, pat);
+			draw_row(game.row - 1);
+			if (!streaming && !remote) {
+				candidates_narrow(&cand, &masks, word, pat);
 			}
 		}
+		if (remote && !game_over(&game)) {
+			/* given up: the server has yet to say what the word was */
+			if (strncmp((reply = remote_ask("giveup")), "answer ", 7)) {
+				remote_fail(reply);
+			}
+			game.word = word_pack(reply + 7);
+		}
 
-		cu_stat_setw("Word was: %s\n", wordlist[word]);
-		if (won) {
-			game_status(i);
+		cu_stat_setw("Word was: %s\n", word_unpack(game.word, word_str));
+		if (game.won) {
+			game_status(game.row - 1);
 		} else {
-			game_status(GAMESTAT_MISS);
+			game_status(GAMESTAT_MISS(row_count));
 		}
-		refresh();
+		render();
 		getch();
 
 		clear();
 		refresh();
+		screen.valid = false;
 	} while (!initial_word); //exits if we have given a word
 	return 0;
 }
@@ -0,0 +1,239 @@
+/* matrix -- precomputed guess x answer pattern table for cordl
+ *
+ * Row g holds the pattern for guessing word g against every word of the
+ * dictionary: one byte each up to five letters, where a pattern fits one, and
+ * one pattern_t each beyond. It is cached as a .cordlpat file, a header
+ * followed by the table, named after and checked against dict_hash().
+*/
+#pragma once
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "xmem.h"
+#include "dict.h"
+#include "score.h"
+#include "par.h"
+
+#define MATRIX_MAGIC "CORDLPAT"
+#define MATRIX_VERSION 3
+/* 4 GiB of table at two bytes a pattern; beyond this it's cheaper to score
+ * on demand */
+#define MATRIX_MAX_WORDS 46340
+/* a tile is this many guesses against this many answers, so the answers
+ * stay in cache while each guess in the tile is scored against them */
+#define MATRIX_TILE_GUESSES 16
+#define MATRIX_TILE_ANSWERS 4096
+
+struct matrix_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t word_len;
+	uint32_t pattern_size;
+	uint32_t pad;
+	uint64_t count;
+	uint64_t dict_hash;
+	char reserved[24];
+};
+
+static_assert(sizeof(struct matrix_header) == 64, "Matrix header should keep the table aligned");
+
+struct pattern_matrix {
+	void *pat;
+	/* bytes per pattern, the scorer's pattern_size */
+	size_t pattern_size;
+	size_t count;
+	void *map;
+	size_t map_len;
+};
+
+/* row g, as bytes or as pattern_t, going by pattern_size */
+#define matrix_row8(m, g) ((const uint8_t *)(m)->pat + (size_t)(g) * (m)->count)
+#define matrix_row16(m, g) ((const pattern_t *)(m)->pat + (size_t)(g) * (m)->count)
+/* pattern for guessing word g when the answer is word a */
+#define matrix_get(m, g, a) ((pattern_t)((m)->pattern_size == 1 ? matrix_row8(m, g)[a] : matrix_row16(m, g)[a]))
+
+struct matrix_build {
+	const word_t *words;
+	size_t count;
+	void *pat;
+	struct scorer score;
+};
+
+static void matrix_build_rows(void *arg, size_t begin, size_t end)
+{
+	struct matrix_build *b = arg;
+	size_t a, g, len;
+
+	for (a = 0; a < b->count; a += MATRIX_TILE_ANSWERS) {
+		len = b->count - a < MATRIX_TILE_ANSWERS ? b->count - a : MATRIX_TILE_ANSWERS;
+		for (g = begin; g < end; ++g) {
+			if (b->score.pattern_size == 1) {
+				b->score.batch8(b->words[g], b->words + a, len, (uint8_t *)b->pat + g * b->count + a);
+			} else {
+				b->score.batch(b->words[g], b->words + a, len, (pattern_t *)b->pat + g * b->count + a);
+			}
+		}
+	}
+}
+
+static void matrix_header_init(struct matrix_header *h, const struct dict *d, size_t pattern_size)
+{
+	memset(h, 0, sizeof(*h));
+	memcpy(h->magic, MATRIX_MAGIC, sizeof(h->magic));
+	h->version = MATRIX_VERSION;
+	h->word_len = d->len;
+	h->pattern_size = pattern_size;
+	h->count = d->count;
+	h->dict_hash = dict_hash(d);
+}
+
+/* map an existing matrix file, if it matches d */
+static bool matrix_load(struct pattern_matrix *m, const struct dict *d, size_t pattern_size, const char *path)
+{
+	struct matrix_header want;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		return false;
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size != sizeof(want) + d->count * d->count * pattern_size) {
+		close(fd);
+		return false;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	matrix_header_init(&want, d, pattern_size);
+	if (memcmp(map, &want, sizeof(want))) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	m->map = map;
+	m->map_len = st.st_size;
+	m->pat = (char *)map + sizeof(want);
+	m->pattern_size = pattern_size;
+	m->count = d->count;
+	return true;
+}
+
+/* Build the matrix for d on threads threads (see par_for()). With a cache_dir,
+ * it is built straight into a new file there and then renamed into place, so
+ * the next call just maps it. Returns -1 with errno set on failure, which
+ * includes dictionaries over MATRIX_MAX_WORDS. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int matrix_open(struct pattern_matrix *m, const struct dict *d, const char *cache_dir, int threads)
+{
+	struct matrix_header h;
+	struct matrix_build b;
+	char *path = NULL, *tmp = NULL, *proc;
+	size_t len;
+	void *map = MAP_FAILED;
+	int fd = -1;
+
+	memset(m, 0, sizeof(*m));
+	if (d->count > MATRIX_MAX_WORDS) {
+		errno = EFBIG;
+		return -1;
+	}
+	if (scorer_init(&b.score, d->len) == -1) {
+		errno = EINVAL;
+		return -1;
+	}
+	matrix_header_init(&h, d, b.score.pattern_size);
+	len = sizeof(h) + d->count * d->count * b.score.pattern_size;
+
+	if (cache_dir) {
+		xasprintf(&path, "%s/cordl_%016llx.cordlpat", cache_dir, (unsigned long long)h.dict_hash);
+		if (matrix_load(m, d, b.score.pattern_size, path)) {
+			free(path);
+			return 0;
+		}
+#ifdef O_TMPFILE
+		/* unnamed until it's complete, so exiting partway through, as a
+		 * build in the background may, leaves nothing behind */
+		fd = open(cache_dir, O_TMPFILE | O_RDWR, 0644);
+#endif
+		if (fd == -1) {
+			xasprintf(&tmp, "%s.%ld", path, (long)getpid());
+			fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		}
+		if (fd != -1 && ftruncate(fd, len) == 0) {
+			map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+	}
+	/* no cache, or we couldn't write one: keep it in memory */
+	if (map == MAP_FAILED) {
+		map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (fd != -1) {
+			close(fd);
+			fd = -1;
+		}
+		if (tmp) {
+			unlink(tmp);
+			free(tmp);
+			tmp = NULL;
+		}
+		if (map == MAP_FAILED) {
+			free(path);
+			return -1;
+		}
+	}
+
+	b.words = d->words;
+	b.count = d->count;
+	b.pat = (char *)map + sizeof(h);
+	par_for(d->count, MATRIX_TILE_GUESSES, threads, matrix_build_rows, &b);
+	/* the header goes in last, so a torn file never looks valid */
+	memcpy(map, &h, sizeof(h));
+
+	if (tmp) {
+		if (msync(map, len, MS_SYNC) == -1 || rename(tmp, path) == -1) {
+			unlink(tmp);
+		}
+		free(tmp);
+	} else if (fd != -1) {
+		/* named only now it's complete, then moved over any stale table,
+		 * as above */
+		xasprintf(&proc, "/proc/self/fd/%d", fd);
+		xasprintf(&tmp, "%s.%ld", path, (long)getpid());
+		unlink(tmp);
+		if (msync(map, len, MS_SYNC) == 0 && linkat(AT_FDCWD, proc, AT_FDCWD, tmp, AT_SYMLINK_FOLLOW) == 0
+				&& rename(tmp, path) == -1) {
+			unlink(tmp);
+		}
+		free(proc);
+		free(tmp);
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	free(path);
+	m->map = map;
+	m->map_len = len;
+	m->pat = b.pat;
+	m->pattern_size = b.score.pattern_size;
+	m->count = d->count;
+	return 0;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void matrix_free(struct pattern_matrix *m)
+{
+	if (m->map) {
+		munmap(m->map, m->map_len);
+	}
+	memset(m, 0, sizeof(*m));
+}
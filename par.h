@@ -0,0 +1,89 @@
+/* par -- a minimal parallel for loop over pthreads
+ *
+ * Work is handed out in chunks from a shared counter, so uneven chunks
+ * balance themselves out. The calling thread works too.
+*/
+#pragma once
+#include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "xmem.h"
+
+typedef void (*par_fn)(void *arg, size_t begin, size_t end);
+
+struct par_job {
+	par_fn fn;
+	void *arg;
+	size_t n;
+	size_t chunk;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+/* number of threads to use by default */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int par_threads(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+static void *par_worker(void *p)
+{
+	struct par_job *job = p;
+	size_t begin, end;
+
+	while (1) {
+		pthread_mutex_lock(&job->lock);
+		begin = job->next;
+		if (begin < job->n) {
+			job->next = begin + job->chunk < job->n ? begin + job->chunk : job->n;
+		}
+		end = job->next;
+		pthread_mutex_unlock(&job->lock);
+		if (begin >= job->n)
+			break;
+		job->fn(job->arg, begin, end);
+	}
+	return NULL;
+}
+
+/* call fn(arg, begin, end) over [0, n) in pieces of at most chunk, on up to
+ * threads threads, or par_threads() if threads <= 0 */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void par_for(size_t n, size_t chunk, int threads, par_fn fn, void *arg)
+{
+	struct par_job job = { fn, arg, n, chunk ? chunk : 1, 0, PTHREAD_MUTEX_INITIALIZER };
+	pthread_t *tid;
+	int i, started;
+
+	if (threads <= 0) {
+		threads = par_threads();
+	}
+	if ((size_t)threads > (n + job.chunk - 1) / job.chunk) {
+		threads = (n + job.chunk - 1) / job.chunk;
+	}
+	if (threads <= 1) {
+		if (n) {
+			fn(arg, 0, n);
+		}
+		return;
+	}
+
+	tid = xcalloc(threads - 1, sizeof(*tid));
+	for (started = 0; started < threads - 1; ++started) {
+		/* if we can't get more threads, we make do */
+		if (pthread_create(tid + started, NULL, par_worker, &job))
+			break;
+	}
+	par_worker(&job);
+	for (i = 0; i < started; ++i) {
+		pthread_join(tid[i], NULL);
+	}
+	free(tid);
+	pthread_mutex_destroy(&job.lock);
+}
@@ -28,6 +28,17 @@ void rnd_pcg_seed( rnd_pcg_t* pcg, RND_U32 seed );
 RND_U32 rnd_pcg_next( rnd_pcg_t* pcg );
 float rnd_pcg_nextf( rnd_pcg_t* pcg );
 int rnd_pcg_range( rnd_pcg_t* pcg, int min, int max );
+RND_U32 rnd_pcg_bounded( rnd_pcg_t* pcg, RND_U32 bound );
+RND_U64 rnd_pcg_bounded64( rnd_pcg_t* pcg, RND_U64 bound );
+void rnd_pcg_seed_stream( rnd_pcg_t* pcg, RND_U32 seed, RND_U64 stream );
+void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta );
+
+#define RND_PCG8_LANES 8
+typedef struct rnd_pcg8_t { RND_U64 state[ RND_PCG8_LANES ]; RND_U64 inc[ RND_PCG8_LANES ]; } rnd_pcg8_t;
+void rnd_pcg8_seed( rnd_pcg8_t* pcg8, RND_U32 const seeds[ RND_PCG8_LANES ] );
+void rnd_pcg8_lane( rnd_pcg8_t const* pcg8, int lane, rnd_pcg_t* pcg );
+void rnd_pcg8_fill( rnd_pcg8_t* pcg8, RND_U32* values, int count );
+void rnd_pcg8_fill_bounded( rnd_pcg8_t* pcg8, RND_U32* values, int count, RND_U32 bound );
 
 typedef struct rnd_well_t { RND_U32 state[ 17 ]; } rnd_well_t;
 void rnd_well_seed( rnd_well_t* well, RND_U32 seed );
@@ -46,6 +57,7 @@ void rnd_xorshift_seed( rnd_xorshift_t* xorshift, RND_U64 seed );
 RND_U64 rnd_xorshift_next( rnd_xorshift_t* xorshift );
 float rnd_xorshift_nextf( rnd_xorshift_t* xorshift );
 int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max );
+RND_U64 rnd_xorshift_bounded64( rnd_xorshift_t* xorshift, RND_U64 bound );
 
 #endif /* rnd_h */
 
@@ -226,7 +238,81 @@ rnd_pcg_range
 
     int rnd_pcg_range( rnd_pcg_t* pcg, int min, int max )
 
-Returns a random integer N in the range: min <= N <= max, from the specified PCG generator.
+Returns a random integer N in the range: min <= N <= max, from the specified PCG generator. Every value in the range is
+equally likely.
+
+
+rnd_pcg_bounded
+---------------
+
+    RND_U32 rnd_pcg_bounded( rnd_pcg_t* pcg, RND_U32 bound )
+
+Returns a random number N in the range: 0 <= N < bound, from the specified PCG generator, or 0 if bound is 0. Uses 
+Lemire's multiply-and-reject method, so there is no bias, and rarely more than one value is drawn.
+
+
+rnd_pcg_bounded64
+-----------------
+
+    RND_U64 rnd_pcg_bounded64( rnd_pcg_t* pcg, RND_U64 bound )
+
+As rnd_pcg_bounded, for 64-bit bounds. Bounds that fit in 32 bits draw exactly as rnd_pcg_bounded does; larger ones
+take two values at a time.
+
+
+rnd_pcg_seed_stream
+-------------------
+
+    void rnd_pcg_seed_stream( rnd_pcg_t* pcg, RND_U32 seed, RND_U64 stream )
+
+Initialize a PCG generator with the specified seed, on one of 2^63 streams. Generators seeded with the same seed on
+different streams produce different, independent sequences.
+
+
+rnd_pcg_advance
+---------------
+
+    void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta )
+
+Moves the specified PCG generator delta values ahead, as if rnd_pcg_next had been called delta times, in a handful of
+multiplications. Since the sequence wraps around after 2^64 values, a delta of 2^64 - n steps n values back. Advancing
+copies of one generator by multiples of a stride gives each its own stretch of the sequence, which never overlaps the
+others as long as none draws more than stride values.
+
+
+rnd_pcg8_seed
+-------------
+
+    void rnd_pcg8_seed( rnd_pcg8_t* pcg8, RND_U32 const seeds[ RND_PCG8_LANES ] )
+
+Initialize RND_PCG8_LANES (8) PCG generators at once, lane i exactly as rnd_pcg_seed would with seeds[ i ]. The lanes
+are advanced together, four to an AVX2 register where the CPU has it, for filling buffers in bulk.
+
+
+rnd_pcg8_lane
+-------------
+
+    void rnd_pcg8_lane( rnd_pcg8_t const* pcg8, int lane, rnd_pcg_t* pcg )
+
+Copies the state of one lane into a scalar PCG generator, which then carries on the lane's sequence.
+
+
+rnd_pcg8_fill
+-------------
+
+    void rnd_pcg8_fill( rnd_pcg8_t* pcg8, RND_U32* values, int count )
+
+Stores count random numbers in values, taking the lanes in turn: values[ i ] comes from lane i % RND_PCG8_LANES, and
+each lane produces exactly what rnd_pcg_next would for a generator seeded like it. When count is not a multiple of
+RND_PCG8_LANES, only the lanes that were used are advanced.
+
+
+rnd_pcg8_fill_bounded
+---------------------
+
+    void rnd_pcg8_fill_bounded( rnd_pcg8_t* pcg8, RND_U32* values, int count, RND_U32 bound )
+
+As rnd_pcg8_fill, but with numbers N in the range 0 <= N < bound, each lane producing exactly what rnd_pcg_bounded would.
 
 
 rnd_well_seed
@@ -321,7 +407,17 @@ rnd_xorshift_range
 
     int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max )
 
-Returns a random integer N in the range: min <= N <= max, from the specified XorShift generator.
+Returns a random integer N in the range: min <= N <= max, from the specified XorShift generator. Every value in the
+range is equally likely.
+
+
+rnd_xorshift_bounded64
+----------------------
+
+    RND_U64 rnd_xorshift_bounded64( rnd_xorshift_t* xorshift, RND_U64 bound )
+
+Returns a random number N in the range: 0 <= N < bound, from the specified XorShift generator, or 0 if bound is 0.
+Uses Lemire's multiply-and-reject method, so there is no bias.
 
 
 */
@@ -336,14 +432,37 @@ Returns a random integer N in the range: min <= N <= max, from the specified Xor
 #ifdef RND_IMPLEMENTATION
 #undef RND_IMPLEMENTATION
 
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+    #define RND_INTERNAL_AVX2
+    #include <immintrin.h>
+#endif
+
 // Convert a randomized RND_U32 value to a float value x in the range 0.0f <= x < 1.0f. Contributed by Jonatan Hedborg
 static float rnd_internal_float_normalized_from_u32( RND_U32 value )
     {
     RND_U32 exponent = 127;
     RND_U32 mantissa = value >> 9;
-    RND_U32 result = ( exponent << 23 ) | mantissa;
-    float fresult = *(float*)( &result );
-    return fresult - 1.0f;
+    union { RND_U32 u; float f; } result;
+    result.u = ( exponent << 23 ) | mantissa;
+    return result.f - 1.0f;
+    }
+
+
+// The full 128-bit product of a and b: returns the high 64 bits, and stores the low ones in low
+static RND_U64 rnd_internal_mul64( RND_U64 a, RND_U64 b, RND_U64* low )
+    {
+    #ifdef __SIZEOF_INT128__
+        unsigned __int128 const m = (unsigned __int128) a * b;
+        *low = (RND_U64) m;
+        return (RND_U64)( m >> 64 );
+    #else
+        RND_U64 const a_lo = a & 0xffffffffULL, a_hi = a >> 32ULL;
+        RND_U64 const b_lo = b & 0xffffffffULL, b_hi = b >> 32ULL;
+        RND_U64 const lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+        RND_U64 const cross = ( lo_lo >> 32ULL ) + ( hi_lo & 0xffffffffULL ) + lo_hi;
+        *low = ( cross << 32ULL ) | ( lo_lo & 0xffffffffULL );
+        return ( hi_lo >> 32ULL ) + ( cross >> 32ULL ) + hi_hi;
+    #endif
     }
 
 
@@ -399,10 +518,208 @@ float rnd_pcg_nextf( rnd_pcg_t* pcg )
 
 int rnd_pcg_range( rnd_pcg_t* pcg, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_pcg_nextf( pcg ) * range );
-    return min + value; 
+    if( max < min ) return min;
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    // a range of all 2^32 ints wraps to 0
+    RND_U32 const value = range ? rnd_pcg_bounded( pcg, range ) : rnd_pcg_next( pcg );
+    return (int) ( (RND_U32) min + value );
+    }
+
+
+// Lemire, "Fast Random Integer Generation in an Interval": the high half of value * bound is in range, and only the
+// lowest ( 2^32 mod bound ) low halves need rejecting to make every result equally likely
+RND_U32 rnd_pcg_bounded( rnd_pcg_t* pcg, RND_U32 bound )
+    {
+    RND_U64 m = (RND_U64) rnd_pcg_next( pcg ) * bound;
+    if( (RND_U32) m < bound )
+        {
+        RND_U32 const threshold = ( 0U - bound ) % bound;
+        while( (RND_U32) m < threshold )
+            m = (RND_U64) rnd_pcg_next( pcg ) * bound;
+        }
+    return (RND_U32)( m >> 32ULL );
+    }
+
+
+RND_U64 rnd_pcg_bounded64( rnd_pcg_t* pcg, RND_U64 bound )
+    {
+    if( bound <= 0xffffffffULL ) return rnd_pcg_bounded( pcg, (RND_U32) bound );
+    RND_U64 low;
+    RND_U64 value = ( (RND_U64) rnd_pcg_next( pcg ) << 32ULL ) | rnd_pcg_next( pcg );
+    RND_U64 high = rnd_internal_mul64( value, bound, &low );
+    if( low < bound )
+        {
+        RND_U64 const threshold = ( 0ULL - bound ) % bound;
+        while( low < threshold )
+            {
+            value = ( (RND_U64) rnd_pcg_next( pcg ) << 32ULL ) | rnd_pcg_next( pcg );
+            high = rnd_internal_mul64( value, bound, &low );
+            }
+        }
+    return high;
+    }
+
+
+void rnd_pcg_seed_stream( rnd_pcg_t* pcg, RND_U32 seed, RND_U64 stream )
+    {
+    RND_U64 value = ( ( (RND_U64) seed ) << 1ULL ) | 1ULL;
+    value = rnd_internal_murmur3_avalanche64( value );
+    pcg->state[ 0 ] = 0U;
+    // the stream picks the (odd) increment, so every stream is a different sequence
+    pcg->state[ 1 ] = ( stream << 1ULL ) | 1ULL;
+    rnd_pcg_next( pcg );
+    pcg->state[ 0 ] += value;
+    rnd_pcg_next( pcg );
+    }
+
+
+// Brown, "Random Number Generation with Arbitrary Strides": delta steps of the LCG, composed by repeated squaring
+void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta )
+    {
+    RND_U64 cur_mult = 0x5851f42d4c957f2dULL;
+    RND_U64 cur_plus = pcg->state[ 1 ];
+    RND_U64 acc_mult = 1U;
+    RND_U64 acc_plus = 0U;
+    while( delta > 0 )
+        {
+        if( delta & 1ULL )
+            {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus * cur_mult + cur_plus;
+            }
+        cur_plus = ( cur_mult + 1ULL ) * cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1ULL;
+        }
+    pcg->state[ 0 ] = acc_mult * pcg->state[ 0 ] + acc_plus;
+    }
+
+
+void rnd_pcg8_seed( rnd_pcg8_t* pcg8, RND_U32 const seeds[ RND_PCG8_LANES ] )
+    {
+    int i;
+    for( i = 0; i < RND_PCG8_LANES; ++i )
+        {
+        rnd_pcg_t pcg;
+        rnd_pcg_seed( &pcg, seeds[ i ] );
+        pcg8->state[ i ] = pcg.state[ 0 ];
+        pcg8->inc[ i ] = pcg.state[ 1 ];
+        }
+    }
+
+
+void rnd_pcg8_lane( rnd_pcg8_t const* pcg8, int lane, rnd_pcg_t* pcg )
+    {
+    pcg->state[ 0 ] = pcg8->state[ lane ];
+    pcg->state[ 1 ] = pcg8->inc[ lane ];
+    }
+
+
+// One value from each lane into values, as rnd_pcg_next would produce them
+static void rnd_internal_pcg8_step( rnd_pcg8_t* pcg8, RND_U32* values )
+    {
+    int i;
+    for( i = 0; i < RND_PCG8_LANES; ++i )
+        {
+        rnd_pcg_t pcg;
+        rnd_pcg8_lane( pcg8, i, &pcg );
+        values[ i ] = rnd_pcg_next( &pcg );
+        pcg8->state[ i ] = pcg.state[ 0 ];
+        }
+    }
+
+
+#ifdef RND_INTERNAL_AVX2
+
+// Four lanes of rnd_pcg_next: the low 32 bits of each 64-bit lane hold the value. AVX2 has no 64-bit multiply, so the
+// state is multiplied in 32-bit halves, dropping the high-by-high product which only affects bits past 64.
+__attribute__(( target( "avx2" ) ))
+static __m256i rnd_internal_pcg8_next4( __m256i* state, __m256i inc )
+    {
+    __m256i const mult_lo = _mm256_set1_epi64x( 0x4c957f2dLL );
+    __m256i const mult_hi = _mm256_set1_epi64x( 0x5851f42dLL );
+    __m256i const old = *state;
+    __m256i cross = _mm256_add_epi64( _mm256_mul_epu32( _mm256_srli_epi64( old, 32 ), mult_lo ), 
+        _mm256_mul_epu32( old, mult_hi ) );
+    *state = _mm256_add_epi64( _mm256_add_epi64( _mm256_mul_epu32( old, mult_lo ), _mm256_slli_epi64( cross, 32 ) ), inc );
+    __m256i const xorshifted = _mm256_and_si256( _mm256_srli_epi64( _mm256_xor_si256( _mm256_srli_epi64( old, 18 ), old ), 27 ),
+        _mm256_set1_epi64x( 0xffffffffLL ) );
+    __m256i const rot = _mm256_srli_epi64( old, 59 );
+    __m256i const left = _mm256_and_si256( _mm256_sub_epi64( _mm256_setzero_si256(), rot ), _mm256_set1_epi64x( 31 ) );
+    return _mm256_or_si256( _mm256_srlv_epi64( xorshifted, rot ), _mm256_sllv_epi64( xorshifted, left ) );
+    }
+
+
+// Full rounds of all lanes, RND_PCG8_LANES values a round, returning how many rounds were done
+__attribute__(( target( "avx2" ) ))
+static int rnd_internal_pcg8_fill_avx2( rnd_pcg8_t* pcg8, RND_U32* values, int rounds )
+    {
+    __m256i const pack = _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 );
+    __m256i lo_state = _mm256_loadu_si256( (__m256i const*) pcg8->state );
+    __m256i hi_state = _mm256_loadu_si256( (__m256i const*) ( pcg8->state + 4 ) );
+    __m256i const lo_inc = _mm256_loadu_si256( (__m256i const*) pcg8->inc );
+    __m256i const hi_inc = _mm256_loadu_si256( (__m256i const*) ( pcg8->inc + 4 ) );
+    int i;
+    for( i = 0; i < rounds; ++i )
+        {
+        // gather the eight low halves, lanes 0-3 then 4-7
+        __m256i const lo = _mm256_permutevar8x32_epi32( rnd_internal_pcg8_next4( &lo_state, lo_inc ), pack );
+        __m256i const hi = _mm256_permutevar8x32_epi32( rnd_internal_pcg8_next4( &hi_state, hi_inc ), pack );
+        _mm256_storeu_si256( (__m256i*) ( values + i * RND_PCG8_LANES ), _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+        }
+    _mm256_storeu_si256( (__m256i*) pcg8->state, lo_state );
+    _mm256_storeu_si256( (__m256i*) ( pcg8->state + 4 ), hi_state );
+    return rounds;
+    }
+
+#endif
+
+
+void rnd_pcg8_fill( rnd_pcg8_t* pcg8, RND_U32* values, int count )
+    {
+    int done = 0;
+    int rounds = count / RND_PCG8_LANES;
+    #ifdef RND_INTERNAL_AVX2
+        if( sizeof( RND_U64 ) == 8 && sizeof( RND_U32 ) == 4 && __builtin_cpu_supports( "avx2" ) )
+            done = rnd_internal_pcg8_fill_avx2( pcg8, values, rounds );
+    #endif
+    for( ; done < rounds; ++done )
+        rnd_internal_pcg8_step( pcg8, values + done * RND_PCG8_LANES );
+    // the lanes left over carry on one at a time
+    for( done *= RND_PCG8_LANES; done < count; ++done )
+        {
+        rnd_pcg_t pcg;
+        rnd_pcg8_lane( pcg8, done % RND_PCG8_LANES, &pcg );
+        values[ done ] = rnd_pcg_next( &pcg );
+        pcg8->state[ done % RND_PCG8_LANES ] = pcg.state[ 0 ];
+        }
+    }
+
+
+void rnd_pcg8_fill_bounded( rnd_pcg8_t* pcg8, RND_U32* values, int count, RND_U32 bound )
+    {
+    RND_U32 const threshold = bound ? ( 0U - bound ) % bound : 0U;
+    int i, j;
+    rnd_pcg8_fill( pcg8, values, count );
+    for( i = 0; i < count; ++i )
+        {
+        RND_U64 m = (RND_U64) values[ i ] * bound;
+        if( (RND_U32) m < threshold )
+            {
+            // rare: retry as rnd_pcg_bounded would, from the lane stepped back to just after this value, then redraw
+            // the lane's later values, which the retries have pushed along
+            rnd_pcg_t pcg;
+            int const lane = i % RND_PCG8_LANES;
+            rnd_pcg8_lane( pcg8, lane, &pcg );
+            rnd_pcg_advance( &pcg, 0ULL - (RND_U64) ( ( count - 1 - lane ) / RND_PCG8_LANES - i / RND_PCG8_LANES ) );
+            while( (RND_U32) m < threshold )
+                m = (RND_U64) rnd_pcg_next( &pcg ) * bound;
+            for( j = i + RND_PCG8_LANES; j < count; j += RND_PCG8_LANES )
+                values[ j ] = rnd_pcg_next( &pcg );
+            pcg8->state[ lane ] = pcg.state[ 0 ];
+            }
+        values[ i ] = (RND_U32)( m >> 32ULL );
+        }
     }
 
 
@@ -510,11 +827,24 @@ float rnd_xorshift_nextf( rnd_xorshift_t* xorshift )
 
 int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_xorshift_next( xorshift ) * range );
-    return min + value; 
-   }
+    if( max < min ) return min;
+    RND_U64 const range = (RND_U64) max - (RND_U64) min + 1ULL;
+    return (int) ( min + (long long) rnd_xorshift_bounded64( xorshift, range ) );
+    }
+
+
+RND_U64 rnd_xorshift_bounded64( rnd_xorshift_t* xorshift, RND_U64 bound )
+    {
+    RND_U64 low;
+    RND_U64 high = rnd_internal_mul64( rnd_xorshift_next( xorshift ), bound, &low );
+    if( low < bound )
+        {
+        RND_U64 const threshold = ( 0ULL - bound ) % bound;
+        while( low < threshold )
+            high = rnd_internal_mul64( rnd_xorshift_next( xorshift ), bound, &low );
+        }
+    return high;
+    }
 
 
 
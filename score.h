@@ -0,0 +1,392 @@
+/* score -- feedback scoring for cordl
+ *
+ * The feedback for a guess is encoded as a pattern: one base-3 digit per
+ * letter, first letter least significant, with the digit values below. This
+ * makes every pattern a small integer that can index a table directly.
+*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sassert.h"
+#include "dict.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCORE_X86
+#include <immintrin.h>
+#endif
+
+enum pattern_digit {
+	PATTERN_WRONG,
+	PATTERN_MISPLACED,
+	PATTERN_RIGHT,
+};
+
+/* 3^WORD_LEN_MAX, enough for a pattern of any length */
+#define PATTERN_MAX 6561
+
+typedef uint16_t pattern_t;
+
+static_assert(WORD_LEN_MIN == 4 && WORD_LEN_MAX == 8, "PATTERN_MAX and SCORE_LENS assume four to eight letters");
+static_assert(PATTERN_MAX - 1 <= UINT16_MAX, "Pattern does not fit in pattern_t");
+
+/* the kernels are compiled once per length, for these */
+#define SCORE_LENS(X) X(4) X(5) X(6) X(7) X(8)
+/* and, for tables, once more for the lengths whose patterns fit a byte */
+#define SCORE_BYTE_LENS(X) X(4) X(5)
+
+static_assert(3 * 3 * 3 * 3 * 3 - 1 <= UINT8_MAX, "Five letter patterns do not fit a byte");
+
+#ifdef __GNUC__
+#define SCORE_INLINE inline __attribute__((always_inline))
+#else
+#define SCORE_INLINE inline
+#endif
+
+/* how many patterns there are for words of len letters, 3^len */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static size_t pattern_count(int len)
+{
+	size_t n = 1;
+	while (len--) {
+		n *= 3;
+	}
+	return n;
+}
+
+/* digit i of pattern p */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static enum pattern_digit pattern_digit(pattern_t p, int i)
+{
+	while (i--) {
+		p /= 3;
+	}
+	return p % 3;
+}
+
+/* Score guess against answer, both len letters. Right letters are matched
+ * first; the rest of the answer's letters are then handed out left to right
+ * as misplaced, so a letter guessed twice is only marked twice if the answer
+ * has it twice. Only ever called with a constant len, which is what the per
+ * length kernels below are for. */
+static SCORE_INLINE pattern_t score_word_len(word_t answer, word_t guess, int len)
+{
+	int i;
+	int word_letters[26] = {0};
+	enum pattern_digit digit[WORD_LEN_MAX];
+	pattern_t p = 0;
+
+	for (i = 0; i < len; ++i) {
+		if (word_letter(answer, i) != word_letter(guess, i)) {
+			++word_letters[word_letter(answer, i)];
+		}
+	}
+	for (i = 0; i < len; ++i) {
+		if (word_letter(guess, i) == word_letter(answer, i)) {
+			digit[i] = PATTERN_RIGHT;
+		} else if (word_letters[word_letter(guess, i)]) {
+			digit[i] = PATTERN_MISPLACED;
+			--word_letters[word_letter(guess, i)];
+		} else {
+			digit[i] = PATTERN_WRONG;
+		}
+	}
+	for (i = len - 1; i >= 0; --i) {
+		p = p * 3 + digit[i];
+	}
+	return p;
+}
+
+/* The batch kernels score one guess against many answers at a time, one
+ * answer per 32-bit lane. Each block of answers is first split into the low
+ * and high halves of the packed words, from which a letter is a shift or two
+ * and a mask. Greens are a compare per position. For duplicates, position i
+ * is misplaced when the answer has more unmatched copies of its letter than
+ * the guess used up in unmatched positions to the left of i, which is what
+ * handing letters out left to right in score_word_len() comes to. Both
+ * store size bytes per pattern, 1 or sizeof(pattern_t), and return how many
+ * answers they scored, a multiple of their width; the caller finishes the
+ * tail. */
+#ifdef SCORE_X86
+/* letter i of the words split into lo and hi */
+__attribute__((target("sse2")))
+static SCORE_INLINE __m128i score_letter_sse2(__m128i lo, __m128i hi, int i)
+{
+	const __m128i lmask = _mm_set1_epi32(LETTER_MASK);
+	int bit = i * LETTER_BITS;
+
+	if (bit + LETTER_BITS <= 32)
+		return _mm_and_si128(_mm_srli_epi32(lo, bit), lmask);
+	if (bit >= 32)
+		return _mm_and_si128(_mm_srli_epi32(hi, bit - 32), lmask);
+	return _mm_and_si128(_mm_or_si128(_mm_srli_epi32(lo, bit), _mm_slli_epi32(hi, 32 - bit)), lmask);
+}
+
+__attribute__((target("sse2")))
+static SCORE_INLINE size_t score_batch_sse2_len(word_t guess, const word_t *answers, size_t n, void *out, int len, int size)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_cmpeq_epi32(zero, zero);
+	const __m128i one = _mm_set1_epi32(PATTERN_MISPLACED);
+	const __m128i two = _mm_set1_epi32(PATTERN_RIGHT);
+	__m128i g[WORD_LEN_MAX], a[WORD_LEN_MAX], right[WORD_LEN_MAX];
+	__m128 v0, v1;
+	__m128i lo, hi, p, cnt, used, misplaced, d;
+	int32_t bytes;
+	int gl[WORD_LEN_MAX];
+	int i, j;
+	size_t w;
+
+	for (i = 0; i < len; ++i) {
+		gl[i] = (guess >> (i * LETTER_BITS)) & LETTER_MASK;
+		g[i] = _mm_set1_epi32(gl[i]);
+	}
+	for (w = 0; w + 4 <= n; w += 4) {
+		v0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(answers + w)));
+		v1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(answers + w + 2)));
+		lo = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+		hi = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+		for (i = 0; i < len; ++i) {
+			a[i] = score_letter_sse2(lo, hi, i);
+			right[i] = _mm_cmpeq_epi32(a[i], g[i]);
+		}
+		p = zero;
+		for (i = len - 1; i >= 0; --i) {
+			/* masks are -1, so subtracting them counts */
+			cnt = zero;
+			for (j = 0; j < len; ++j) {
+				cnt = _mm_sub_epi32(cnt, _mm_andnot_si128(right[j], _mm_cmpeq_epi32(a[j], g[i])));
+			}
+			used = zero;
+			for (j = 0; j < i; ++j) {
+				if (gl[j] == gl[i]) {
+					used = _mm_sub_epi32(used, _mm_andnot_si128(right[j], ones));
+				}
+			}
+			misplaced = _mm_andnot_si128(right[i], _mm_cmpgt_epi32(cnt, used));
+			d = _mm_or_si128(_mm_and_si128(right[i], two), _mm_and_si128(misplaced, one));
+			p = _mm_add_epi32(_mm_add_epi32(p, _mm_add_epi32(p, p)), d);
+		}
+		/* patterns are below 2^15, so the signed pack is exact */
+		p = _mm_packs_epi32(p, p);
+		if (size == 1) {
+			bytes = _mm_cvtsi128_si32(_mm_packus_epi16(p, p));
+			memcpy((uint8_t *)out + w, &bytes, sizeof(bytes));
+		} else {
+			_mm_storel_epi64((__m128i *)((pattern_t *)out + w), p);
+		}
+	}
+	return w;
+}
+
+__attribute__((target("avx2")))
+static SCORE_INLINE __m256i score_letter_avx2(__m256i lo, __m256i hi, int i)
+{
+	const __m256i lmask = _mm256_set1_epi32(LETTER_MASK);
+	int bit = i * LETTER_BITS;
+
+	if (bit + LETTER_BITS <= 32)
+		return _mm256_and_si256(_mm256_srli_epi32(lo, bit), lmask);
+	if (bit >= 32)
+		return _mm256_and_si256(_mm256_srli_epi32(hi, bit - 32), lmask);
+	return _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi32(lo, bit), _mm256_slli_epi32(hi, 32 - bit)), lmask);
+}
+
+__attribute__((target("avx2")))
+static SCORE_INLINE size_t score_batch_avx2_len(word_t guess, const word_t *answers, size_t n, void *out, int len, int size)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_cmpeq_epi32(zero, zero);
+	const __m256i one = _mm256_set1_epi32(PATTERN_MISPLACED);
+	const __m256i two = _mm256_set1_epi32(PATTERN_RIGHT);
+	/* gathers the low dwords of four words into the low half */
+	const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	__m256i g[WORD_LEN_MAX], a[WORD_LEN_MAX], right[WORD_LEN_MAX];
+	__m256i v0, v1, lo, hi, p, cnt, used, misplaced, d;
+	__m128i q;
+	int gl[WORD_LEN_MAX];
+	int i, j;
+	size_t w;
+
+	for (i = 0; i < len; ++i) {
+		gl[i] = (guess >> (i * LETTER_BITS)) & LETTER_MASK;
+		g[i] = _mm256_set1_epi32(gl[i]);
+	}
+	for (w = 0; w + 8 <= n; w += 8) {
+		v0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(answers + w)), split);
+		v1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(answers + w + 4)), split);
+		lo = _mm256_permute2x128_si256(v0, v1, 0x20);
+		hi = _mm256_permute2x128_si256(v0, v1, 0x31);
+		for (i = 0; i < len; ++i) {
+			a[i] = score_letter_avx2(lo, hi, i);
+			right[i] = _mm256_cmpeq_epi32(a[i], g[i]);
+		}
+		p = zero;
+		for (i = len - 1; i >= 0; --i) {
+			cnt = zero;
+			for (j = 0; j < len; ++j) {
+				cnt = _mm256_sub_epi32(cnt, _mm256_andnot_si256(right[j], _mm256_cmpeq_epi32(a[j], g[i])));
+			}
+			used = zero;
+			for (j = 0; j < i; ++j) {
+				if (gl[j] == gl[i]) {
+					used = _mm256_sub_epi32(used, _mm256_andnot_si256(right[j], ones));
+				}
+			}
+			misplaced = _mm256_andnot_si256(right[i], _mm256_cmpgt_epi32(cnt, used));
+			d = _mm256_or_si256(_mm256_and_si256(right[i], two), _mm256_and_si256(misplaced, one));
+			p = _mm256_add_epi32(_mm256_add_epi32(p, _mm256_add_epi32(p, p)), d);
+		}
+		q = _mm_packs_epi32(_mm256_castsi256_si128(p), _mm256_extracti128_si256(p, 1));
+		if (size == 1) {
+			_mm_storel_epi64((__m128i *)((uint8_t *)out + w), _mm_packus_epi16(q, q));
+		} else {
+			_mm_storeu_si128((__m128i *)((pattern_t *)out + w), q);
+		}
+	}
+	return w;
+}
+#endif
+
+/* score_word_N and score_batch_*_N, for each length N */
+#define SCORE_KERNEL_SCALAR(len) \
+static pattern_t score_word_##len(word_t answer, word_t guess) \
+{ \
+	return score_word_len(answer, guess, len); \
+} \
+static void score_batch_scalar_##len(word_t guess, const word_t *answers, size_t n, pattern_t *out) \
+{ \
+	size_t i; \
+	for (i = 0; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+}
+SCORE_LENS(SCORE_KERNEL_SCALAR)
+
+/* score_batch8_scalar_N, into bytes */
+#define SCORE_KERNEL_BYTE_SCALAR(len) \
+static void score_batch8_scalar_##len(word_t guess, const word_t *answers, size_t n, uint8_t *out) \
+{ \
+	size_t i; \
+	for (i = 0; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+}
+SCORE_BYTE_LENS(SCORE_KERNEL_BYTE_SCALAR)
+
+#ifdef SCORE_X86
+#define SCORE_KERNEL_X86(len) \
+__attribute__((target("sse2"))) \
+static void score_batch_sse2_##len(word_t guess, const word_t *answers, size_t n, pattern_t *out) \
+{ \
+	size_t i = score_batch_sse2_len(guess, answers, n, out, len, sizeof(*out)); \
+	for (; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+} \
+__attribute__((target("avx2"))) \
+static void score_batch_avx2_##len(word_t guess, const word_t *answers, size_t n, pattern_t *out) \
+{ \
+	size_t i = score_batch_avx2_len(guess, answers, n, out, len, sizeof(*out)); \
+	for (; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+}
+SCORE_LENS(SCORE_KERNEL_X86)
+
+#define SCORE_KERNEL_BYTE_X86(len) \
+__attribute__((target("sse2"))) \
+static void score_batch8_sse2_##len(word_t guess, const word_t *answers, size_t n, uint8_t *out) \
+{ \
+	size_t i = score_batch_sse2_len(guess, answers, n, out, len, sizeof(*out)); \
+	for (; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+} \
+__attribute__((target("avx2"))) \
+static void score_batch8_avx2_##len(word_t guess, const word_t *answers, size_t n, uint8_t *out) \
+{ \
+	size_t i = score_batch_avx2_len(guess, answers, n, out, len, sizeof(*out)); \
+	for (; i < n; ++i) { \
+		out[i] = score_word_len(answers[i], guess, len); \
+	} \
+}
+SCORE_BYTE_LENS(SCORE_KERNEL_BYTE_X86)
+#endif
+
+/* The kernels for one word length, picked once up front so that the hot
+ * loops make no decisions. patterns is pattern_count(len). */
+struct scorer {
+	int len;
+	size_t patterns;
+	/* bytes a pattern takes in a table: 1 where batch8 is there, else
+	 * sizeof(pattern_t) */
+	size_t pattern_size;
+	/* score guess against answer */
+	pattern_t (*word)(word_t answer, word_t guess);
+	/* score guess against each of the n answers, into out */
+	void (*batch)(word_t guess, const word_t *answers, size_t n, pattern_t *out);
+	/* the same into bytes, for lengths whose patterns fit one; else NULL */
+	void (*batch8)(word_t guess, const word_t *answers, size_t n, uint8_t *out);
+};
+
+#ifdef SCORE_X86
+/* these only test bits libgcc has already filled in at startup */
+#define SCORE_PICK(s, len) do { \
+	(s)->word = score_word_##len; \
+	if (__builtin_cpu_supports("avx2")) { \
+		(s)->batch = score_batch_avx2_##len; \
+	} else if (__builtin_cpu_supports("sse2")) { \
+		(s)->batch = score_batch_sse2_##len; \
+	} else { \
+		(s)->batch = score_batch_scalar_##len; \
+	} \
+} while (0)
+#define SCORE_PICK_BYTE(s, len) do { \
+	(s)->pattern_size = 1; \
+	if (__builtin_cpu_supports("avx2")) { \
+		(s)->batch8 = score_batch8_avx2_##len; \
+	} else if (__builtin_cpu_supports("sse2")) { \
+		(s)->batch8 = score_batch8_sse2_##len; \
+	} else { \
+		(s)->batch8 = score_batch8_scalar_##len; \
+	} \
+} while (0)
+#else
+#define SCORE_PICK(s, len) do { \
+	(s)->word = score_word_##len; \
+	(s)->batch = score_batch_scalar_##len; \
+} while (0)
+#define SCORE_PICK_BYTE(s, len) do { \
+	(s)->pattern_size = 1; \
+	(s)->batch8 = score_batch8_scalar_##len; \
+} while (0)
+#endif
+
+/* pick the kernels for len letter words, the fastest this CPU can run;
+ * -1 if len isn't supported */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int scorer_init(struct scorer *s, int len)
+{
+	s->len = len;
+	s->patterns = pattern_count(len);
+	s->pattern_size = sizeof(pattern_t);
+	s->batch8 = NULL;
+	switch (len) {
+#define SCORE_CASE(len) case len: SCORE_PICK_BYTE(s, len); break;
+		SCORE_BYTE_LENS(SCORE_CASE)
+#undef SCORE_CASE
+	}
+	switch (len) {
+#define SCORE_CASE(len) case len: SCORE_PICK(s, len); return 0;
+		SCORE_LENS(SCORE_CASE)
+#undef SCORE_CASE
+	}
+	return -1;
+}
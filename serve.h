@@ -0,0 +1,321 @@
+/* serve -- many games of cordl from one process, over a unix socket
+ *
+ * The server holds the words once and plays a game for every connection,
+ * all from one thread on an epoll loop, so an idle session costs only its
+ * struct serve_session. Clients do the drawing. The protocol is lines of
+ * text, one reply line to each request line:
+ *
+ *	(on connecting)	<- cordl LEN ROWS
+ *	new		<- ok			start a game, dropping any other
+ *	guess WORD	<- pattern DIGITS	a digit per letter: 0 wrong,
+ *			<- pattern DIGITS WORD	1 misplaced, 2 right; with the
+ *			<- invalid		answer once the game is over
+ *	giveup		<- answer WORD		ending the game
+ *	quit				closes the connection
+ *
+ * and error REASON to anything out of turn. What each request does is up
+ * to the handler passed to serve_run(); this is just the plumbing.
+*/
+#pragma once
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "xmem.h"
+#include "game.h"
+
+/* the longest request line, and the replies held for a client that isn't
+ * reading them */
+#define SERVE_LINE_MAX 64
+#define SERVE_OUT_MAX 256
+/* reading stops while a reply this long might not fit */
+#define SERVE_REPLY_MAX 64
+#define SERVE_BACKLOG 128
+#define SERVE_EVENTS 256
+
+struct serve_session {
+	int fd;
+	struct game game;
+	char in[SERVE_LINE_MAX];
+	size_t in_len;
+	char out[SERVE_OUT_MAX];
+	size_t out_len;
+	/* waiting for the client to take its replies */
+	bool blocked;
+	/* to be closed once the replies are sent */
+	bool closing;
+};
+
+/* Handle one request line, without its newline, queueing the reply with
+ * serve_reply(). Returns false to close the session. */
+typedef bool (*serve_fn)(void *arg, struct serve_session *s, char *line);
+
+/* queue a line to s */
+#ifdef __GNUC__
+__attribute__((unused, format(printf, 2, 3)))
+#endif
+static void serve_reply(struct serve_session *s, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(s->out + s->out_len, SERVE_OUT_MAX - s->out_len - 1, fmt, ap);
+	va_end(ap);
+	if (n < 0 || (size_t)n >= SERVE_OUT_MAX - s->out_len - 1)
+		return;
+	s->out_len += n;
+	s->out[s->out_len++] = '\n';
+}
+
+/* fill in addr for path; -1 if it's too long for a unix socket */
+static int serve_addr(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr->sun_path, path);
+	return 0;
+}
+
+/* Connect to the server at path, returning the socket or -1 with errno
+ * set. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int serve_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (serve_addr(&addr, path) == -1)
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void serve_close(int ep, struct serve_session *s)
+{
+	epoll_ctl(ep, EPOLL_CTL_DEL, s->fd, NULL);
+	close(s->fd);
+	free(s);
+}
+
+/* send what can be sent; false if the client has gone */
+static bool serve_flush(struct serve_session *s)
+{
+	ssize_t n;
+
+	while (s->out_len) {
+		if ((n = send(s->fd, s->out, s->out_len, MSG_NOSIGNAL)) == -1) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+		s->out_len -= n;
+		memmove(s->out, s->out + n, s->out_len);
+	}
+	return true;
+}
+
+/* Handle the complete lines read so far, while there's room for their
+ * replies. False if the session is to be closed at once; a handler asking
+ * for it only has the session closed after its replies. */
+static bool serve_lines(struct serve_session *s, serve_fn fn, void *arg)
+{
+	char *nl;
+	size_t used;
+
+	while (SERVE_OUT_MAX - s->out_len >= SERVE_REPLY_MAX && (nl = memchr(s->in, '\n', s->in_len))) {
+		*nl = '\0';
+		if (nl > s->in && nl[-1] == '\r') {
+			nl[-1] = '\0';
+		}
+		if (!fn(arg, s, s->in)) {
+			/* anything sent after is ignored */
+			s->closing = true;
+			s->in_len = 0;
+			return true;
+		}
+		used = nl + 1 - s->in;
+		s->in_len -= used;
+		memmove(s->in, s->in + used, s->in_len);
+	}
+	if (s->in_len == SERVE_LINE_MAX && !memchr(s->in, '\n', s->in_len)) {
+		serve_reply(s, "error line too long");
+		serve_flush(s);
+		return false;
+	}
+	return true;
+}
+
+/* answer the lines read so far, until they run out or the client stops
+ * taking the replies */
+static bool serve_pump(struct serve_session *s, serve_fn fn, void *arg)
+{
+	do {
+		if (!serve_lines(s, fn, arg) || !serve_flush(s))
+			return false;
+	} while (!s->out_len && memchr(s->in, '\n', s->in_len));
+	return !s->closing || s->out_len;
+}
+
+/* read what the client has sent and answer it */
+static bool serve_read(struct serve_session *s, serve_fn fn, void *arg)
+{
+	ssize_t n;
+
+	if ((n = read(s->fd, s->in + s->in_len, SERVE_LINE_MAX - s->in_len)) <= 0) {
+		return n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+	s->in_len += n;
+	return serve_pump(s, fn, arg);
+}
+
+/* Watch for input while the client is keeping up, and for room to write
+ * while it has replies waiting. */
+static bool serve_watch(int ep, struct serve_session *s)
+{
+	struct epoll_event ev;
+	bool blocked = s->out_len != 0;
+
+	if (blocked == s->blocked)
+		return true;
+	ev.events = blocked ? EPOLLOUT : EPOLLIN;
+	ev.data.ptr = s;
+	s->blocked = blocked;
+	return epoll_ctl(ep, EPOLL_CTL_MOD, s->fd, &ev) == 0;
+}
+
+/* take every waiting connection, greeting each with len and rows */
+static void serve_accept(int ep, int listener, int *spare, int len, int rows)
+{
+	struct serve_session *s;
+	struct epoll_event ev;
+	int fd;
+
+	for (;;) {
+		if ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1) {
+			if (errno == EMFILE || errno == ENFILE) {
+				/* out of descriptors: turn the client away rather than
+				 * have the listener wake us up forever */
+				close(*spare);
+				if ((fd = accept(listener, NULL, NULL)) != -1) {
+					close(fd);
+				}
+				*spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+				continue;
+			}
+			return;
+		}
+		s = xcalloc(1, sizeof(*s));
+		s->fd = fd;
+		ev.events = EPOLLIN;
+		ev.data.ptr = s;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			close(fd);
+			free(s);
+			continue;
+		}
+		serve_reply(s, "cordl %d %d", len, rows);
+		if (!serve_flush(s) || !serve_watch(ep, s)) {
+			serve_close(ep, s);
+		}
+	}
+}
+
+/* Serve games of len letters in rows rows at path, replacing any socket
+ * left there but not one still being served, handing every request to fn.
+ * Only returns on failure, with errno set. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int serve_run(const char *path, int len, int rows, serve_fn fn, void *arg)
+{
+	struct epoll_event ev, events[SERVE_EVENTS];
+	struct serve_session *s;
+	struct sockaddr_un addr;
+	struct rlimit nofile;
+	struct stat st;
+	int ep, listener, spare, n, i;
+	bool ok;
+
+	if (serve_addr(&addr, path) == -1)
+		return -1;
+	/* every session is a descriptor */
+	if (getrlimit(RLIMIT_NOFILE, &nofile) == 0 && nofile.rlim_cur < nofile.rlim_max) {
+		nofile.rlim_cur = nofile.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &nofile);
+	}
+	/* a socket is only left over if nothing answers on it */
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		if ((listener = serve_connect(path)) != -1) {
+			close(listener);
+			errno = EADDRINUSE;
+			return -1;
+		}
+		if (errno == ECONNREFUSED) {
+			unlink(path);
+		}
+	}
+	if ((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+		return -1;
+	if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(listener, SERVE_BACKLOG) == -1
+			|| (ep = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		close(listener);
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev) == -1) {
+		close(ep);
+		close(listener);
+		return -1;
+	}
+	spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	for (;;) {
+		if ((n = epoll_wait(ep, events, SERVE_EVENTS, -1)) == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (i = 0; i < n; ++i) {
+			if (!(s = events[i].data.ptr)) {
+				serve_accept(ep, listener, &spare, len, rows);
+				continue;
+			}
+			if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+				ok = false;
+			} else if (s->blocked) {
+				/* room to write again: carry on with what was left */
+				ok = serve_pump(s, fn, arg);
+			} else {
+				ok = serve_read(s, fn, arg);
+			}
+			if (!ok || !serve_watch(ep, s)) {
+				serve_close(ep, s);
+			}
+		}
+	}
+	close(spare);
+	close(ep);
+	close(listener);
+	return -1;
+}
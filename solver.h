@@ -0,0 +1,453 @@
+/* solver -- candidate tracking and guess ranking for cordl
+ *
+ * Candidates are the answers still consistent with every row played so far.
+ * Guesses are ranked by the entropy of the pattern they would produce over
+ * those candidates, i.e. the expected information gained by playing them.
+ * Openers, first guesses against every answer, are also ranked by how many
+ * candidates they would leave, on average and at worst.
+*/
+#pragma once
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "xmem.h"
+#include "dict.h"
+#include "score.h"
+#include "matrix.h"
+#include "par.h"
+#include "hard.h"
+
+#define HINT_COUNT 5
+/* guesses handed to a worker at a time */
+#define HINT_CHUNK 256
+
+/* Precomputed bitsets over the dictionary, one bit per word: which words have
+ * a letter at a position, and which have at least k copies of a letter. Any
+ * row's feedback comes down to a handful of these, ANDed in or out. */
+struct letter_masks {
+	int len;
+	size_t words;
+	uint64_t *pos;
+	uint64_t *atleast;
+};
+
+/* mask of words with letter l at position i */
+#define masks_pos(m, i, l) ((m)->pos + ((size_t)(i) * 26 + (l)) * (m)->words)
+/* mask of words with at least k (1 to len) copies of letter l */
+#define masks_atleast(m, l, k) ((m)->atleast + ((size_t)(l) * (m)->len + (k) - 1) * (m)->words)
+
+static int popcount64(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll(x);
+#else
+	int n;
+	for (n = 0; x; ++n) {
+		x &= x - 1;
+	}
+	return n;
+#endif
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void masks_build(struct letter_masks *m, const struct dict *d)
+{
+	int copies[26];
+	size_t w;
+	int i, k, l;
+
+	m->len = d->len;
+	m->words = (d->count + 63) / 64;
+	m->pos = xcalloc(m->words * m->len * 26, sizeof(*m->pos));
+	m->atleast = xcalloc(m->words * 26 * m->len, sizeof(*m->atleast));
+	for (w = 0; w < d->count; ++w) {
+		memset(copies, 0, sizeof(copies));
+		for (i = 0; i < m->len; ++i) {
+			l = word_letter(d->words[w], i);
+			masks_pos(m, i, l)[w / 64] |= 1ull << (w % 64);
+			++copies[l];
+		}
+		for (l = 0; l < 26; ++l) {
+			for (k = 1; k <= copies[l]; ++k) {
+				masks_atleast(m, l, k)[w / 64] |= 1ull << (w % 64);
+			}
+		}
+	}
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void masks_free(struct letter_masks *m)
+{
+	free(m->pos);
+	free(m->atleast);
+	memset(m, 0, sizeof(*m));
+}
+
+/* The candidates, as a bitset over the dictionary. idx lists them by index
+ * once candidates_list() has been called. */
+struct candidates {
+	uint64_t *set;
+	size_t words;
+	size_t count;
+	uint32_t *idx;
+};
+
+/* every word of d is a candidate */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void candidates_reset(struct candidates *c, const struct dict *d)
+{
+	c->words = (d->count + 63) / 64;
+	c->set = xreallocarray(c->set, c->words ? c->words : 1, sizeof(*c->set));
+	memset(c->set, 0xff, c->words * sizeof(*c->set));
+	if (d->count % 64) {
+		c->set[c->words - 1] = (1ull << (d->count % 64)) - 1;
+	}
+	c->count = d->count;
+}
+
+/* Keep only the candidates that would have given pattern p for guess.
+ * Right letters must be there, and no other position may hold the letter
+ * guessed there. A letter guessed k times without being marked wrong must
+ * appear at least k times, and if a copy was marked wrong, exactly k times.
+ * All of that is applied in one pass over the set. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void candidates_narrow(struct candidates *c, const struct letter_masks *m, word_t guess, pattern_t p)
+{
+	/* at most one mask per position, and two per distinct letter */
+	const uint64_t *mask[WORD_LEN_MAX * 3];
+	bool invert[WORD_LEN_MAX * 3];
+	int found[26] = {0}, wrong[26] = {0};
+	enum pattern_digit digit;
+	int i, l, n = 0;
+	size_t w, count = 0;
+	uint64_t v;
+
+	for (i = 0; i < m->len; ++i) {
+		l = word_letter(guess, i);
+		digit = pattern_digit(p, i);
+		mask[n] = masks_pos(m, i, l);
+		invert[n++] = digit != PATTERN_RIGHT;
+		if (digit == PATTERN_WRONG) {
+			wrong[l] = 1;
+		} else {
+			++found[l];
+		}
+	}
+	for (l = 0; l < 26; ++l) {
+		if (found[l]) {
+			mask[n] = masks_atleast(m, l, found[l]);
+			invert[n++] = false;
+		}
+		if (wrong[l] && found[l] < m->len) {
+			mask[n] = masks_atleast(m, l, found[l] + 1);
+			invert[n++] = true;
+		}
+	}
+
+	for (w = 0; w < c->words; ++w) {
+		v = c->set[w];
+		for (i = 0; i < n && v; ++i) {
+			v &= invert[i] ? ~mask[i][w] : mask[i][w];
+		}
+		c->set[w] = v;
+		count += popcount64(v);
+	}
+	c->count = count;
+}
+
+/* fill in and return c->idx */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static const uint32_t *candidates_list(struct candidates *c)
+{
+	size_t w, n = 0;
+	uint64_t v;
+
+	c->idx = xreallocarray(c->idx, c->count ? c->count : 1, sizeof(*c->idx));
+	for (w = 0; w < c->words; ++w) {
+		for (v = c->set[w]; v; v &= v - 1) {
+#ifdef __GNUC__
+			c->idx[n++] = w * 64 + __builtin_ctzll(v);
+#else
+			c->idx[n++] = w * 64 + popcount64((v & -v) - 1);
+#endif
+		}
+	}
+	return c->idx;
+}
+
+struct hint {
+	word_t word;
+	double bits;
+	bool candidate;
+};
+
+/* whether a ranks above b: more information first, then guesses that could
+ * win outright */
+static bool hint_better(const struct hint *a, const struct hint *b)
+{
+	if (a->bits != b->bits)
+		return a->bits > b->bits;
+	return a->candidate && !b->candidate;
+}
+
+/* insert h into the sorted list best of n, unless it's already there */
+static void hint_insert(struct hint *best, int n, const struct hint *h)
+{
+	int i, j;
+
+	for (i = 0; i < n && best[i].word; ++i) {
+		if (best[i].word == h->word)
+			return;
+	}
+	for (i = 0; i < n && best[i].word && !hint_better(h, best + i); ++i);
+	if (i == n)
+		return;
+	for (j = n - 1; j > i; --j) {
+		best[j] = best[j - 1];
+	}
+	best[i] = *h;
+}
+
+struct hint_job {
+	const struct dict *d;
+	/* guesses that aren't in d, always scored on the fly */
+	const word_t *extra;
+	size_t extras;
+	const struct pattern_matrix *m;
+	struct scorer score;
+	const uint32_t *cand;
+	size_t count;
+	/* candidate words, for scoring without a matrix */
+	const word_t *cand_words;
+	/* n log2 n for every possible bucket size */
+	const double *nlogn;
+	bool *is_cand;
+	/* the guesses hard mode allows, or NULL for any */
+	const struct hard *rules;
+	int n;
+	struct hint *best;
+	pthread_mutex_t lock;
+};
+
+static void hint_rank_chunk(void *arg, size_t begin, size_t end)
+{
+	struct hint_job *job = arg;
+	struct hint local[HINT_COUNT], h;
+	uint32_t hist[PATTERN_MAX];
+	pattern_t *pat = NULL;
+	size_t g, i, count = job->count;
+	const pattern_t *row;
+	const uint8_t *row8;
+	bool in_d;
+	word_t w;
+	double sum;
+	int p;
+
+	memset(local, 0, sizeof(local));
+	if (job->cand_words) {
+		pat = xcalloc(count ? count : 1, sizeof(*pat));
+	}
+	for (g = begin; g < end; ++g) {
+		in_d = g < job->d->count;
+		w = in_d ? job->d->words[g] : job->extra[g - job->d->count];
+		if (job->rules && !hard_allows(job->rules, w))
+			continue;
+		memset(hist, 0, job->score.patterns * sizeof(*hist));
+		if (!in_d || !job->m->pat) {
+			job->score.batch(w, job->cand_words, count, pat);
+			for (i = 0; i < count; ++i) {
+				++hist[pat[i]];
+			}
+		} else if (job->m->pattern_size == 1) {
+			row8 = matrix_row8(job->m, g);
+			for (i = 0; i < count; ++i) {
+				++hist[row8[job->cand[i]]];
+			}
+		} else {
+			row = matrix_row16(job->m, g);
+			for (i = 0; i < count; ++i) {
+				++hist[row[job->cand[i]]];
+			}
+		}
+		sum = 0;
+		for (p = 0; p < (int)job->score.patterns; ++p) {
+			sum += job->nlogn[hist[p]];
+		}
+		h.word = w;
+		h.bits = log2(count) - sum / count;
+		h.candidate = in_d && job->is_cand[g];
+		hint_insert(local, job->n, &h);
+	}
+	free(pat);
+
+	pthread_mutex_lock(&job->lock);
+	for (i = 0; i < (size_t)job->n && local[i].word; ++i) {
+		hint_insert(job->best, job->n, local + i);
+	}
+	pthread_mutex_unlock(&job->lock);
+}
+
+/* Rank every word of d, and the extras words of extra that aren't in it, as
+ * a guess against the count candidates of d listed in cand, storing the top n
+ * (at most HINT_COUNT) in best; with rules, only the words they allow are
+ * ranked. Patterns for d's words come from m where it has been built, and
+ * are scored on the fly otherwise. The tables for it are left in scratch,
+ * for the caller to reset. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void hint_rank(const struct dict *d, const word_t *extra, size_t extras, const struct pattern_matrix *m,
+		const uint32_t *cand, size_t count, const struct hard *rules, struct hint *best, int n, int threads, struct xarena *scratch)
+{
+	struct hint_job job;
+	word_t *cand_words = NULL;
+	double *nlogn;
+	size_t i;
+
+	memset(best, 0, n * sizeof(*best));
+	if (!count)
+		return;
+
+	nlogn = xarena_calloc(scratch, count + 1, sizeof(*nlogn));
+	for (i = 2; i <= count; ++i) {
+		nlogn[i] = i * log2(i);
+	}
+	job.is_cand = xarena_calloc(scratch, d->count, sizeof(*job.is_cand));
+	for (i = 0; i < count; ++i) {
+		job.is_cand[cand[i]] = true;
+	}
+	if (!m->pat || extras) {
+		cand_words = xarena_calloc(scratch, count, sizeof(*cand_words));
+		for (i = 0; i < count; ++i) {
+			cand_words[i] = d->words[cand[i]];
+		}
+	}
+
+	job.d = d;
+	job.extra = extra;
+	job.extras = extras;
+	job.m = m;
+	scorer_init(&job.score, d->len);
+	job.cand = cand;
+	job.count = count;
+	job.cand_words = cand_words;
+	job.nlogn = nlogn;
+	job.rules = rules;
+	job.n = n < HINT_COUNT ? n : HINT_COUNT;
+	job.best = best;
+	pthread_mutex_init(&job.lock, NULL);
+	par_for(d->count + extras, HINT_CHUNK, threads, hint_rank_chunk, &job);
+	pthread_mutex_destroy(&job.lock);
+}
+
+/* A first guess, against all the answers: the candidates it leaves on
+ * average, the bits it gains, and what its worst pattern leaves. answer is
+ * whether it could win outright. */
+struct opener {
+	word_t word;
+	double left;
+	double bits;
+	uint32_t worst;
+	bool answer;
+};
+
+/* openers handed to a worker at a time */
+#define OPENER_CHUNK 64
+
+struct opener_job {
+	const struct dict *answers;
+	struct scorer score;
+	const double *nlogn;
+	struct opener *op;
+};
+
+static void opener_rank_chunk(void *arg, size_t begin, size_t end)
+{
+	struct opener_job *job = arg;
+	size_t count = job->answers->count, g, i;
+	pattern_t *pat = xcalloc(count, sizeof(*pat));
+	uint32_t hist[PATTERN_MAX] = {0};
+	struct opener *o;
+	uint64_t squares;
+	double sum;
+	int p;
+
+	for (g = begin; g < end; ++g) {
+		o = job->op + g;
+		job->score.batch(o->word, job->answers->words, count, pat);
+		for (i = 0; i < count; ++i) {
+			++hist[pat[i]];
+		}
+		squares = 0;
+		sum = 0;
+		o->worst = 0;
+		/* the histogram is left cleared for the next one */
+		for (p = 0; p < (int)job->score.patterns; ++p) {
+			squares += (uint64_t)hist[p] * hist[p];
+			sum += job->nlogn[hist[p]];
+			if (hist[p] > o->worst) {
+				o->worst = hist[p];
+			}
+			hist[p] = 0;
+		}
+		o->left = (double)squares / count;
+		o->bits = log2(count) - sum / count;
+	}
+	free(pat);
+}
+
+/* fewest left on average first, then most information, then the smallest
+ * worst case, then those that could win */
+static int opener_cmp(const void *a, const void *b)
+{
+	const struct opener *x = a, *y = b;
+
+	if (x->left != y->left)
+		return x->left < y->left ? -1 : 1;
+	if (x->bits != y->bits)
+		return x->bits > y->bits ? -1 : 1;
+	if (x->worst != y->worst)
+		return x->worst < y->worst ? -1 : 1;
+	if (x->answer != y->answer)
+		return x->answer ? -1 : 1;
+	return (x->word > y->word) - (x->word < y->word);
+}
+
+/* Rate each of the n openers in op, whose word and answer are filled in,
+ * against every word of answers, and sort them best first. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void opener_rank(const struct dict *answers, struct opener *op, size_t n, int threads)
+{
+	struct opener_job job;
+	double *nlogn;
+	size_t i;
+
+	if (!answers->count)
+		return;
+	nlogn = xcalloc(answers->count + 1, sizeof(*nlogn));
+	for (i = 2; i <= answers->count; ++i) {
+		nlogn[i] = i * log2(i);
+	}
+	job.answers = answers;
+	scorer_init(&job.score, answers->len);
+	job.nlogn = nlogn;
+	job.op = op;
+	par_for(n, OPENER_CHUNK, threads, opener_rank_chunk, &job);
+	free(nlogn);
+	qsort(op, n, sizeof(*op), opener_cmp);
+}
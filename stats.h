@@ -0,0 +1,146 @@
+/* stats -- the game statistics file for cordl
+ *
+ * The file is GAMESTAT_LEN(rows) size_t: wins by row, misses, and the total,
+ * which doubles as a checksum. It is shared by every instance, each holding a
+ * lock on it only while reading and writing it back. Every word length and
+ * row count keeps a file of its own.
+*/
+#pragma once
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "xmem.h"
+#include "dict.h"
+
+/* the row counts that can be played */
+#define ROW_MIN 1
+#define ROW_MAX 9
+#define ROW_DEFAULT 6
+
+#define GAMESTAT_MISS(rows) (rows) /* miss location in gamestat*/
+#define GAMESTAT_SUM(rows) ((rows) + 1) /* Total games played */
+#define GAMESTAT_LEN(rows) (GAMESTAT_SUM(rows) + 1) /* store miss, and a checksum at the end*/
+/* big enough for any row count */
+#define GAMESTAT_MAX GAMESTAT_LEN(ROW_MAX)
+
+/* how hard to try for the stats lock before leaving it for next time */
+#define GAMESTAT_LOCK_TRIES 20
+#define GAMESTAT_LOCK_WAIT_NS 25000000L
+
+/* calculate the sum, based on rows and miss. DO NOT STORE */
+static size_t sum_game_stat(const size_t gs[static GAMESTAT_MAX], int rows)
+{
+	size_t sum = 0;
+	int i;
+	for (i = 0; i < GAMESTAT_SUM(rows); ++i) {
+		sum += gs[i];
+	}
+	return sum;
+}
+
+static int valid_game_stat(const size_t gs[static GAMESTAT_MAX], int rows)
+{
+	return gs[GAMESTAT_SUM(rows)] == sum_game_stat(gs, rows);
+}
+
+/* The stats file for words of len letters in rows rows, or NULL without a
+ * HOME. Five letters in six rows keeps the original name. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static char *game_stat_path(int len, int rows)
+{
+	char *path;
+
+	if (!getenv("HOME")) {
+		return NULL;
+	}
+	if (len == WORD_LEN_DEFAULT && rows == ROW_DEFAULT) {
+		xasprintf(&path, "%s/.local/share/cordl_stat", getenv("HOME"));
+	} else {
+		xasprintf(&path, "%s/.local/share/cordl_stat_%dx%d", getenv("HOME"), len, rows);
+	}
+	return path;
+}
+
+/* open and lock the stats file at path, which is freed */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int open_game_stat(char *path)
+{
+	int fd, tries;
+	struct timespec wait = { 0, GAMESTAT_LOCK_WAIT_NS };
+	if (!path) {
+		return -1;
+	}
+	if ((fd = open(path, O_RDWR | O_CREAT, 0755)) == -1) {
+		free(path);
+		return -1;
+	}
+	/* never block on another instance holding it */
+	for (tries = 0; lockf(fd, F_TLOCK, GAMESTAT_MAX * sizeof(size_t)) == -1; ++tries) {
+		if ((errno != EACCES && errno != EAGAIN) || tries == GAMESTAT_LOCK_TRIES) {
+			close(fd);
+			free(path);
+			return -1;
+		}
+		nanosleep(&wait, NULL);
+	}
+	free(path);
+	return fd;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void close_game_stat(int fd)
+{
+	if (fd == -1) {
+		return;
+	}
+
+	lockf(fd, F_ULOCK, GAMESTAT_MAX * sizeof(size_t));
+	close(fd);
+}
+
+/* read the file into gs, if it holds valid stats for rows rows */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static bool load_game_stat(int fd, size_t gs[static GAMESTAT_MAX], int rows)
+{
+	size_t gs_in[GAMESTAT_MAX];
+	ssize_t len = GAMESTAT_LEN(rows) * sizeof(*gs_in);
+
+	if (fd == -1) {
+		return false;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	if (read(fd, gs_in, len) == len) {
+		if (valid_game_stat(gs_in, rows)) {
+			memcpy(gs, gs_in, len);
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void store_game_stat(int fd, const size_t gs[static GAMESTAT_MAX], int rows)
+{
+	if (fd == -1) {
+		return;
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	write(fd, gs, GAMESTAT_LEN(rows) * sizeof(*gs));
+}
@@ -0,0 +1,109 @@
+/* stream -- one pass target selection for cordl
+ *
+ * For word sources too big to hold, or that can only be read once (pipes).
+ * The input is read a block at a time through the usual ingest, and only
+ * words of the length being played are kept, in a word_set for checking
+ * guesses. Targets are drawn by reservoir sampling: the i-th distinct word
+ * replaces a random one of the STREAM_TARGETS kept with probability
+ * STREAM_TARGETS / i, which leaves every word equally likely to be kept
+ * whatever the size of the input.
+*/
+#pragma once
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xmem.h"
+#include "rnd.h"
+#include "dict.h"
+
+/* bytes read at a time; longer lines can't be words and are skipped */
+#define STREAM_BLOCK (1 << 20)
+/* targets kept for drawing games from */
+#define STREAM_TARGETS 64
+
+struct stream_sample {
+	struct word_set set;
+	word_t target[STREAM_TARGETS];
+	size_t targets;
+};
+
+/* offer each word of d in turn to the set, and the new ones to the sample */
+static void stream_sample_dict(struct stream_sample *s, const struct dict *d, rnd_pcg_t *pcg)
+{
+	size_t i, j;
+
+	for (i = 0; i < d->count; ++i) {
+		if (!word_set_add(&s->set, d->words[i]))
+			continue;
+		if (s->targets < STREAM_TARGETS) {
+			s->target[s->targets++] = d->words[i];
+		} else if ((j = rnd_pcg_bounded64(pcg, s->set.count)) < STREAM_TARGETS) {
+			s->target[j] = d->words[i];
+		}
+	}
+}
+
+/* Read f to the end, sampling targets of len letters into s. Returns -1
+ * with errno set on a read error. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int stream_sample(struct stream_sample *s, FILE *f, int len, rnd_pcg_t *pcg)
+{
+	struct lexicon block;
+	char *buf = xmalloc(STREAM_BLOCK);
+	size_t have = 0, got, end;
+	/* in the middle of a line too long to be a word */
+	bool skip = false;
+	char *nl;
+	int n;
+
+	memset(s, 0, sizeof(*s));
+	word_set_init(&s->set, len);
+	lexicon_init(&block);
+	do {
+		got = fread(buf + have, 1, STREAM_BLOCK - have, f);
+		have += got;
+		if (skip) {
+			if (!(nl = memchr(buf, '\n', have))) {
+				have = 0;
+				continue;
+			}
+			have -= nl + 1 - buf;
+			memmove(buf, nl + 1, have);
+			skip = false;
+		}
+		/* hold back a partial last line until the rest is read */
+		end = have;
+		if (got) {
+			for (end = have; end && buf[end - 1] != '\n'; --end);
+			if (!end && have == STREAM_BLOCK) {
+				skip = true;
+				have = 0;
+				continue;
+			}
+		}
+		lexicon_load_buf(&block, buf, end);
+		stream_sample_dict(s, &block.by_len[len], pcg);
+		for (n = WORD_LEN_MIN; n <= WORD_LEN_MAX; ++n) {
+			block.by_len[n].count = 0;
+		}
+		have -= end;
+		memmove(buf, buf + end, have);
+	} while (got);
+	lexicon_free(&block);
+	free(buf);
+	return ferror(f) ? -1 : 0;
+}
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void stream_sample_free(struct stream_sample *s)
+{
+	word_set_free(&s->set);
+	memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,216 @@
+/* trace -- keypress to paint latency tracing for cordl
+ *
+ * Each key read starts an event, which runs until the next frame has been
+ * sent to the terminal. Time in between is charged to whichever phase was
+ * current, switching with trace_enter(), so an event comes down to how long
+ * it spent handling input, validating a guess or, in hard mode, the letters
+ * typed so far, syncing stats, drawing and refreshing. Events go to the
+ * trace file as they finish, one line each, and trace_report() sums them up
+ * at exit.
+ *
+ * Nothing is recorded until trace_open() succeeds, so the hooks can be left
+ * in place at no real cost.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "xmem.h"
+
+enum trace_phase {
+	TRACE_INPUT,
+	TRACE_VALIDATE,
+	TRACE_STATS,
+	TRACE_DRAW,
+	TRACE_REFRESH,
+	TRACE__COUNT,
+};
+
+static const char *const trace_phase_name[TRACE__COUNT] = {
+	[TRACE_INPUT] = "input",
+	[TRACE_VALIDATE] = "validate",
+	[TRACE_STATS] = "stats",
+	[TRACE_DRAW] = "draw",
+	[TRACE_REFRESH] = "refresh",
+};
+
+/* total latency histogram buckets, by powers of two of microseconds */
+#define TRACE_BUCKETS 24
+
+static struct {
+	FILE *f;
+	/* an event is in progress */
+	bool active;
+	int key;
+	enum trace_phase phase;
+	uint64_t start, last;
+	uint64_t ns[TRACE__COUNT];
+	/* every finished event, the phases followed by the total */
+	uint64_t *done;
+	size_t count, alloc;
+} tracing;
+
+static uint64_t trace_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* start tracing into path; -1 with errno set if it can't be opened */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static int trace_open(const char *path)
+{
+	int i;
+
+	if (!(tracing.f = fopen(path, "w")))
+		return -1;
+	fprintf(tracing.f, "# event key");
+	for (i = 0; i < TRACE__COUNT; ++i) {
+		fprintf(tracing.f, " %s_ns", trace_phase_name[i]);
+	}
+	fprintf(tracing.f, " total_ns\n");
+	return 0;
+}
+
+/* key was just read */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void trace_key(int key)
+{
+	if (!tracing.f)
+		return;
+	memset(tracing.ns, 0, sizeof(tracing.ns));
+	tracing.active = true;
+	tracing.key = key;
+	tracing.phase = TRACE_INPUT;
+	tracing.start = tracing.last = trace_now();
+}
+
+/* charge the time from here on to phase p, returning the phase it was in */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static enum trace_phase trace_enter(enum trace_phase p)
+{
+	enum trace_phase prev = tracing.phase;
+	uint64_t t;
+
+	if (!tracing.active)
+		return prev;
+	t = trace_now();
+	tracing.ns[tracing.phase] += t - tracing.last;
+	tracing.last = t;
+	tracing.phase = p;
+	return prev;
+}
+
+/* the frame is on screen, finishing the event */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void trace_paint(void)
+{
+	uint64_t *rec;
+	int i;
+
+	if (!tracing.active)
+		return;
+	trace_enter(TRACE_INPUT);
+	tracing.active = false;
+
+	if (tracing.count == tracing.alloc) {
+		tracing.alloc = tracing.alloc ? tracing.alloc * 2 : 256;
+		tracing.done = xreallocarray(tracing.done, tracing.alloc, sizeof(*tracing.done) * (TRACE__COUNT + 1));
+	}
+	rec = tracing.done + tracing.count * (TRACE__COUNT + 1);
+	rec[TRACE__COUNT] = tracing.last - tracing.start;
+	fprintf(tracing.f, "%zu %d", ++tracing.count, tracing.key);
+	for (i = 0; i < TRACE__COUNT; ++i) {
+		rec[i] = tracing.ns[i];
+		fprintf(tracing.f, " %" PRIu64, rec[i]);
+	}
+	fprintf(tracing.f, " %" PRIu64 "\n", rec[TRACE__COUNT]);
+}
+
+static int trace_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* value at fraction q of the sorted v of n */
+static uint64_t trace_quantile(const uint64_t *v, size_t n, double q)
+{
+	size_t i = q * n;
+	return v[i < n ? i : n - 1];
+}
+
+/* Print p50/p99/max per phase and a histogram of the total to f, and close
+ * the trace file. */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void trace_report(FILE *f)
+{
+	size_t hist[TRACE_BUCKETS] = {0};
+	uint64_t *v, us;
+	size_t i, peak = 0;
+	int p, b, last = 0;
+
+	if (!tracing.f)
+		return;
+	fclose(tracing.f);
+	tracing.f = NULL;
+	if (!tracing.count) {
+		fprintf(f, "No events traced\n");
+		return;
+	}
+
+	v = xcalloc(tracing.count, sizeof(*v));
+	fprintf(f, "%zu events (us)     p50        p99        max\n", tracing.count);
+	for (p = 0; p <= TRACE__COUNT; ++p) {
+		for (i = 0; i < tracing.count; ++i) {
+			v[i] = tracing.done[i * (TRACE__COUNT + 1) + p];
+		}
+		qsort(v, tracing.count, sizeof(*v), trace_cmp);
+		fprintf(f, "%-12s %10.1f %10.1f %10.1f\n", p < TRACE__COUNT ? trace_phase_name[p] : "total",
+				trace_quantile(v, tracing.count, 0.5) / 1e3,
+				trace_quantile(v, tracing.count, 0.99) / 1e3,
+				v[tracing.count - 1] / 1e3);
+	}
+	/* v is left holding the sorted totals */
+	for (i = 0; i < tracing.count; ++i) {
+		us = v[i] / 1000;
+		for (b = 0; b < TRACE_BUCKETS - 1 && us >= (1u << b); ++b);
+		++hist[b];
+		last = b > last ? b : last;
+	}
+	for (b = 0; b <= last; ++b) {
+		peak = hist[b] > peak ? hist[b] : peak;
+	}
+	fprintf(f, "\ntotal latency\n");
+	for (b = 0; b <= last; ++b) {
+		if (b < TRACE_BUCKETS - 1) {
+			fprintf(f, "< %-8lu %8zu ", 1ul << b, hist[b]);
+		} else {
+			fprintf(f, "%-10s %8zu ", "more", hist[b]);
+		}
+		for (i = 0; i < hist[b] * 40 / peak; ++i) {
+			fputc('#', f);
+		}
+		fputc('\n', f);
+	}
+	free(v);
+	free(tracing.done);
+	tracing.done = NULL;
+	tracing.count = tracing.alloc = 0;
+}
@@ -1,6 +1,6 @@
 /* xmem -- memory operations that can only fail catastrophically
  *
- * Version 1.3
+ * Version 1.4
  *
  * Copyright 2021 Ryan Farley <ryan.farley@gmx.com>
  *
@@ -95,6 +95,119 @@ static void xasprintf(char **strp, const char *fmt, ...)
 	xvasprintf(strp, fmt, ap);
 	va_end(ap);
 }
+/* An arena hands out memory from big blocks one piece after the other, so
+ * an allocation is a pointer bump. Pieces are never freed on their own, only
+ * all at once: xarena_reset() keeps the blocks to be used again, and
+ * xarena_free() gives them back. A zeroed struct xarena is empty and ready
+ * to use. */
+#define XARENA_BLOCK (64 * 1024)
+
+/* every piece is aligned for any of these */
+union xarena_align {
+	long double ld;
+	long long ll;
+	void *p;
+	void (*fn)(void);
+};
+#define XARENA_ALIGN sizeof(union xarena_align)
+
+struct xarena_block {
+	struct xarena_block *next;
+	size_t size;
+	union xarena_align data[];
+};
+
+struct xarena {
+	struct xarena_block *head, *cur;
+	/* bytes of cur handed out */
+	size_t used;
+};
+
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void *xarena_alloc(struct xarena *a, size_t len)
+{
+	struct xarena_block *b;
+	size_t size;
+	void *ret;
+
+	if (len > SIZE_MAX - sizeof(*b) - XARENA_ALIGN)
+		abort();
+	len = (len + XARENA_ALIGN - 1) / XARENA_ALIGN * XARENA_ALIGN;
+	if (!a->cur || a->cur->size - a->used < len) {
+		if (a->cur && a->cur->next && a->cur->next->size >= len) {
+			/* kept from before a reset */
+			a->cur = a->cur->next;
+		} else {
+			size = len > XARENA_BLOCK ? len : XARENA_BLOCK;
+			b = xmalloc(sizeof(*b) + size);
+			b->size = size;
+			if (a->cur) {
+				b->next = a->cur->next;
+				a->cur->next = b;
+			} else {
+				b->next = a->head;
+				a->head = b;
+			}
+			a->cur = b;
+		}
+		a->used = 0;
+	}
+	ret = (char *)a->cur->data + a->used;
+	a->used += len;
+	return ret;
+}
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void *xarena_calloc(struct xarena *a, size_t nmemb, size_t size)
+{
+	void *ret;
+	if (size && nmemb > SIZE_MAX / size) {
+		abort();
+	}
+	ret = xarena_alloc(a, nmemb * size);
+	memset(ret, 0, nmemb * size);
+	return ret;
+}
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static char *xarena_strndup(struct xarena *a, const char *str, size_t len)
+{
+	char *ret;
+	if (!str)
+		return NULL;
+	len = strnlen(str, len);
+	ret = xarena_alloc(a, len + 1);
+	memcpy(ret, str, len);
+	ret[len] = '\0';
+	return ret;
+}
+/* everything allocated is gone, but the blocks are kept for what's next */
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void xarena_reset(struct xarena *a)
+{
+	a->cur = a->head;
+	a->used = 0;
+}
+#ifdef __GNUC__
+__attribute__((unused))
+#endif
+static void xarena_free(struct xarena *a)
+{
+	struct xarena_block *b;
+
+	while ((b = a->head)) {
+		a->head = b->next;
+		free(b);
+	}
+	a->cur = NULL;
+	a->used = 0;
+}
 #ifdef __GNUC__
 __attribute__((unused))
 #endif